@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <iostream>
 #include <string_view>
+#include <vector>
 
 #include "lib/sdl2w/Animation.h"
+#include "lib/sdl2w/AnimationSystem.h"
 #include "lib/sdl2w/AssetLoader.h"
 #include "lib/sdl2w/Draw.h"
 #include "lib/sdl2w/L10n.h"
@@ -8,6 +12,12 @@
 #include "lib/sdl2w/Init.h"
 #include "lib/sdl2w/Window.h"
 
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
 void runProgram(int argc, char** argv) {
   const int w = 640;
   const int h = 480;
@@ -33,6 +43,13 @@ void runProgram(int argc, char** argv) {
   // sdl2w::L10n::setLanguage("default");
 
   window.getDraw().setBackgroundColor({0, 0, 145});
+  window.setBackgroundParams({
+      .unfocused = sdl2w::BG_THROTTLE,
+      .unfocusedFps = 15,
+      .hidden = sdl2w::BG_SUSPEND,
+      .duckPct = 30,
+  });
+  window.setPerfOverlayToggleKey(SDLK_F3);
 
   sdl2w::AssetLoader assetLoader(window.getDraw(), window.getStore());
   window.getStore().loadAndStoreFont("default", "assets/monofonto.ttf");
@@ -201,12 +218,250 @@ void runProgram(int argc, char** argv) {
   window.startRenderLoop(_loadLoop, _onLoaded, _mainLoop);
 }
 
+// Stress mode (--stress) ramps up a population of animated sprites, text
+// labels, primitives and sound triggers until the frame time no longer fits
+// the budget, then reports the largest population that held 60 FPS in each
+// draw mode.  Vsync and the frame limiter are off so frame time is the cost
+// of the frame.  Pass --headless to run on the dummy drivers, where both
+// modes use the software renderer.  Native only: it runs the loop to
+// completion once per mode.
+//
+//   ./SDL2W_EXAMPLE --stress [--headless] [--stress-mode gpu|cpu|both]
+//                   [--stress-budget-ms <ms>]
+
+struct StressConfig {
+  bool headless = false;
+  double budgetMs = 1000. / 60.;
+  std::vector<sdl2w::DrawMode> modes = {sdl2w::DrawMode::GPU,
+                                        sdl2w::DrawMode::CPU};
+};
+
+// frames run at each population before and while measuring
+constexpr int STRESS_WARMUP_FRAMES = 15;
+constexpr int STRESS_MEASURE_FRAMES = 90;
+constexpr int STRESS_START_N = 100;
+constexpr int STRESS_MAX_N = 1000000;
+constexpr int STRESS_MAX_STEPS = 40;
+
+struct StressEntities {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> vx;
+  std::vector<double> vy;
+  std::vector<sdl2w::AnimationSystem::Handle> anims;
+};
+
+int runStressMode(sdl2w::DrawMode mode, const StressConfig& config) {
+  const int w = 640;
+  const int h = 480;
+  const char* modeName = mode == sdl2w::DrawMode::GPU ? "GPU" : "CPU";
+
+  sdl2w::Store store;
+  sdl2w::Window window(store,
+                       {
+                           .mode = mode,
+                           .title = std::string("SDL2W Stress ") + modeName,
+                           .w = w,
+                           .h = h,
+                           .x = 25,
+                           .y = 50,
+                           .renderW = w,
+                           .renderH = h,
+                           .headless = config.headless,
+                           .presentMode = sdl2w::PresentMode::VSYNC_OFF,
+                       });
+  window.setInitTimeMax(0);
+  window.getDraw().setBackgroundColor({0, 0, 145});
+
+  sdl2w::AssetLoader assetLoader(window.getDraw(), store);
+  store.loadAndStoreFont("default", "assets/monofonto.ttf");
+  assetLoader.loadAssetsFromFile(sdl2w::ASSET_FILE, "assets/assets.txt");
+
+  sdl2w::Draw& d = window.getDraw();
+  sdl2w::AnimationSystem anims(store);
+  StressEntities entities;
+  std::vector<std::string> labels;
+  for (int i = 0; i < 16; i++) {
+    labels.push_back("unit " + std::to_string(i));
+  }
+
+  auto resize = [&](int n) {
+    while (static_cast<int>(entities.anims.size()) < n) {
+      entities.x.push_back(rand() % w);
+      entities.y.push_back(rand() % h);
+      entities.vx.push_back((rand() % 200 - 100) / 1000.);
+      entities.vy.push_back((rand() % 200 - 100) / 1000.);
+      entities.anims.push_back(anims.create("ken_walk", rand() % 2 == 0));
+    }
+    while (static_cast<int>(entities.anims.size()) > n) {
+      anims.destroy(entities.anims.back());
+      entities.x.pop_back();
+      entities.y.pop_back();
+      entities.vx.pop_back();
+      entities.vy.pop_back();
+      entities.anims.pop_back();
+    }
+  };
+
+  int n = STRESS_START_N;
+  int lastGoodN = 0;
+  int firstBadN = 0;
+  int step = 0;
+  int frameInStep = 0;
+  resize(n);
+
+  // Returns false when the search is over.  Grows n by half while every step
+  // fits the budget, then bisects between the last good and first bad n.
+  auto finishStep = [&]() {
+    const sdl2w::FrameStatsSummary summary =
+        window.getFrameStats().summarize();
+    LOG(INFO) << "[stress] " << modeName << " n=" << n
+              << " avg=" << summary.avgMs << "ms p95=" << summary.p95Ms << "ms"
+              << LOG_ENDL;
+    if (summary.p95Ms <= config.budgetMs) {
+      lastGoodN = n;
+    } else {
+      firstBadN = n;
+    }
+    step++;
+    if (firstBadN == 0) {
+      n = std::max(n + 50, n * 3 / 2);
+      if (n > STRESS_MAX_N) {
+        return false;
+      }
+    } else {
+      if (firstBadN - lastGoodN <= std::max(10, lastGoodN / 50)) {
+        return false;
+      }
+      n = (lastGoodN + firstBadN) / 2;
+    }
+    return step < STRESS_MAX_STEPS;
+  };
+
+  auto _loadLoop = [&]() { return true; };
+  auto _onLoaded = [&]() {};
+  auto _mainLoop = [&]() {
+    const double dt = window.getDeltaTimeMs();
+    const int count = static_cast<int>(entities.anims.size());
+
+    // update
+    anims.update(static_cast<int>(dt));
+    for (int i = 0; i < count; i++) {
+      entities.x[i] += entities.vx[i] * dt;
+      entities.y[i] += entities.vy[i] * dt;
+      if (entities.x[i] < 0 || entities.x[i] > w) {
+        entities.vx[i] = -entities.vx[i];
+      }
+      if (entities.y[i] < 0 || entities.y[i] > h) {
+        entities.vy[i] = -entities.vy[i];
+      }
+    }
+    if (frameInStep % 10 == 0) {
+      window.playSound("test1");
+    }
+
+    // draw
+    for (int i = 0; i < count; i++) {
+      const int x = static_cast<int>(entities.x[i]);
+      const int y = static_cast<int>(entities.y[i]);
+      d.drawAnimation(anims,
+                      entities.anims[i],
+                      sdl2w::RenderableParams{.scale = {1., 1.},
+                                              .x = x,
+                                              .y = y,
+                                              .centered = true});
+      if (i % 2 == 0) {
+        d.drawRect(x - 20, y - 56, 40, 4, {40, 220, 40, 255});
+      }
+      if (i % 4 == 0) {
+        d.drawText(labels[i % labels.size()],
+                   sdl2w::RenderTextParams{
+                       .fontSize = sdl2w::TextSize::TEXT_SIZE_12,
+                       .x = x,
+                       .y = y - 70,
+                       .color = {255, 255, 255},
+                       .centered = true});
+      }
+      if (i % 16 == 0) {
+        d.drawLine({x, y}, {w / 2, h / 2}, 1, {255, 200, 0, 255});
+      }
+    }
+    d.drawText(std::string(modeName) + " n=" + std::to_string(count),
+               sdl2w::RenderTextParams{.x = 8, .y = 8, .color = {255, 255, 0}});
+
+    // ramp
+    frameInStep++;
+    if (frameInStep == STRESS_WARMUP_FRAMES) {
+      window.getFrameStats().clear();
+    } else if (frameInStep == STRESS_WARMUP_FRAMES + STRESS_MEASURE_FRAMES) {
+      if (!finishStep()) {
+        return false;
+      }
+      resize(n);
+      frameInStep = 0;
+    }
+    return true;
+  };
+
+  window.startRenderLoop(_loadLoop, _onLoaded, _mainLoop);
+  if (window.getSdlWindow() != nullptr) {
+    SDL_HideWindow(window.getSdlWindow());
+  }
+  LOG(INFO) << "[stress] " << modeName << " max n at "
+            << 1000. / config.budgetMs << " FPS: " << lastGoodN << LOG_ENDL;
+  // a headless window destroys its renderer, and the textures with it
+  store.clear();
+  return lastGoodN;
+}
+
+int runStress(const StressConfig& config) {
+  std::vector<std::pair<std::string, int>> results;
+  for (const sdl2w::DrawMode mode : config.modes) {
+    results.push_back({mode == sdl2w::DrawMode::GPU ? "GPU" : "CPU",
+                       runStressMode(mode, config)});
+  }
+
+  // one line of JSON on stdout so scripts can track the numbers
+  std::cout << "{\"stress\": {\"budgetMs\": " << config.budgetMs
+            << ", \"headless\": " << (config.headless ? "true" : "false");
+  for (const auto& [modeName, maxN] : results) {
+    std::cout << ", \"" << modeName << "\": " << maxN;
+  }
+  std::cout << "}}" << std::endl;
+  return 0;
+}
+
 int main(int argc, char** argv) {
   LOG(INFO) << "Start program" << LOG_ENDL;
-  sdl2w::Window::init();
+
+  bool stress = false;
+  StressConfig stressConfig;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--stress") {
+      stress = true;
+    } else if (arg == "--headless") {
+      stressConfig.headless = true;
+    } else if (arg == "--stress-budget-ms" && i + 1 < argc) {
+      stressConfig.budgetMs = std::stod(argv[++i]);
+    } else if (arg == "--stress-mode" && i + 1 < argc) {
+      const std::string modeArg = argv[++i];
+      if (modeArg == "gpu") {
+        stressConfig.modes = {sdl2w::DrawMode::GPU};
+      } else if (modeArg == "cpu") {
+        stressConfig.modes = {sdl2w::DrawMode::CPU};
+      }
+    }
+  }
+
+  sdl2w::Window::init({.headless = stressConfig.headless});
   srand(time(NULL));
 
-  runProgram(argc, argv);
+  if (stress) {
+    runStress(stressConfig);
+  } else {
+    runProgram(argc, argv);
+  }
 
   sdl2w::Window::unInit();
   LOG(INFO) << "End program" << LOG_ENDL;
@@ -0,0 +1,379 @@
+// AssetBench measures startup asset loading.  It generates a synthetic asset
+// tree (PNG sprite sheets, animations, WAVs and translation files, with
+// configurable counts), then times AssetLoader::loadAssetsFromFile,
+// Store::loadAndStoreFont and L10n::init.  Each phase reports wall time, heap
+// allocations (C++ and SDL_malloc only, see BenchCommon.h), peak RSS and a
+// breakdown (parse, decode, upload, ...) taken from the library's profiling
+// zones, as JSON.
+//
+// Textures are uploaded to SDL's software renderer on the dummy video driver,
+// so upload numbers track SDL2W's own overhead rather than a GPU driver's.
+//
+//   make bench
+//   ./build/release/bench/AssetBench [--pictures <n>] [--sheet-size <px>]
+//       [--sprite-size <px>] [--anims <n>] [--frames <n>] [--sounds <n>]
+//       [--sound-ms <ms>] [--strings <n>] [--languages <n>] [--font <path>]
+//       [--dir <path>] [--out <path>] [--trace <path>]
+
+#include "../lib/AssetLoader.h"
+#include "../lib/L10n.h"
+#include "../lib/Logger.h"
+#include "../lib/Profiler.h"
+#include "../lib/Store.h"
+#include "../lib/Window.h"
+#include "BenchCommon.h"
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#include <SDL_image.h>
+#else
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#endif
+
+using namespace sdl2w;
+using namespace sdl2w::bench;
+
+using ZoneTotals = std::map<std::string, ProfileZoneTotal>;
+
+struct AssetBenchConfig {
+  int numPictures = 1000;
+  int sheetSize = 256;
+  int spriteSize = 32;
+  int numAnims = 2000;
+  int framesPerAnim = 8;
+  int numSounds = 200;
+  int soundMs = 500;
+  int numStrings = 20000;
+  int numLanguages = 2;
+  std::string fontPath = "../example/assets/monofonto.ttf";
+  std::string dir =
+      (std::filesystem::temp_directory_path() / "sdl2w-assetbench").string();
+  std::string outPath;
+  std::string tracePath;
+};
+
+struct PhaseResult {
+  std::string name;
+  double ms = 0.;
+  AllocationCount allocs;
+  uint64_t peakRssBytes = 0;
+  // derived from profiling zones, in the order they are reported
+  std::vector<std::pair<std::string, double>> breakdownMs;
+};
+
+void writeSheet(const std::string& path, int size, int seed) {
+  SDL_Surface* surf = SDL_CreateRGBSurfaceWithFormat(
+      0, size, size, 32, SDL_PIXELFORMAT_ARGB8888);
+  // gradient plus noise in the low bits, so PNG compression has about as much
+  // to do as it would with real art
+  uint32_t rng = 2463534242u + static_cast<uint32_t>(seed) * 7919u;
+  for (int y = 0; y < size; y++) {
+    Uint32* row = reinterpret_cast<Uint32*>(static_cast<Uint8*>(surf->pixels) +
+                                            y * surf->pitch);
+    for (int x = 0; x < size; x++) {
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      const Uint8 r = static_cast<Uint8>((x * 255 / size) ^ (rng & 0xf));
+      const Uint8 g = static_cast<Uint8>((y * 255 / size) ^ ((rng >> 4) & 0xf));
+      const Uint8 b = static_cast<Uint8>(seed * 31 ^ ((rng >> 8) & 0xf));
+      row[x] = SDL_MapRGBA(surf->format, r, g, b, 255);
+    }
+  }
+  IMG_SavePNG(surf, path.c_str());
+  SDL_FreeSurface(surf);
+}
+
+void writeLe(std::ofstream& file, uint32_t value, int numBytes) {
+  for (int i = 0; i < numBytes; i++) {
+    file.put(static_cast<char>((value >> (i * 8)) & 0xff));
+  }
+}
+
+void writeWav(const std::string& path, int ms, int seed) {
+  constexpr double PI = 3.14159265358979323846;
+  const int sampleRate = 22050;
+  const uint32_t numSamples = static_cast<uint32_t>(sampleRate * ms / 1000);
+  const uint32_t dataBytes = numSamples * 2;
+  std::ofstream file(path, std::ios::binary);
+  file.write("RIFF", 4);
+  writeLe(file, 36 + dataBytes, 4);
+  file.write("WAVEfmt ", 8);
+  writeLe(file, 16, 4);             // fmt chunk size
+  writeLe(file, 1, 2);              // PCM
+  writeLe(file, 1, 2);              // mono
+  writeLe(file, sampleRate, 4);     // sample rate
+  writeLe(file, sampleRate * 2, 4); // byte rate
+  writeLe(file, 2, 2);              // block align
+  writeLe(file, 16, 2);             // bits per sample
+  file.write("data", 4);
+  writeLe(file, dataBytes, 4);
+  const double freq = 220. + seed % 24 * 20.;
+  for (uint32_t i = 0; i < numSamples; i++) {
+    const double v = std::sin(2. * PI * freq * i / sampleRate);
+    writeLe(file, static_cast<uint16_t>(static_cast<int16_t>(v * 8000.)), 2);
+  }
+}
+
+std::vector<std::string> getLanguages(int numLanguages) {
+  std::vector<std::string> langs = {"en"};
+  for (int i = 1; i < numLanguages; i++) {
+    langs.push_back("l" + std::to_string(i));
+  }
+  return langs;
+}
+
+// Writes the tree under config.dir/assets, with paths relative to config.dir
+// the way a game ships them.
+void generateAssets(const AssetBenchConfig& config) {
+  namespace fs = std::filesystem;
+  const fs::path assetsDir = fs::path(config.dir) / "assets";
+  fs::remove_all(assetsDir);
+  fs::create_directories(assetsDir / "pics");
+  fs::create_directories(assetsDir / "sounds");
+
+  const int spritesPerRow = config.sheetSize / config.spriteSize;
+  const int spritesPerSheet = spritesPerRow * spritesPerRow;
+  std::ofstream manifest(assetsDir / "assets.txt");
+  for (int i = 0; i < config.numPictures; i++) {
+    const std::string name = "pic_" + std::to_string(i);
+    writeSheet((assetsDir / "pics" / (name + ".png")).string(),
+               config.sheetSize,
+               i);
+    manifest << "Pic," << name << ",assets/pics/" << name << ".png\n";
+    manifest << "Sprites," << name << "," << spritesPerSheet << ","
+             << config.spriteSize << "," << config.spriteSize << "\n";
+  }
+  for (int i = 0; i < config.numAnims && config.numPictures > 0; i++) {
+    manifest << "Anim,anim_" << i << "," << (i % 2 == 0 ? "loop" : "noloop")
+             << "\n";
+    const int pic = i % config.numPictures;
+    for (int f = 0; f < config.framesPerAnim; f++) {
+      manifest << "pic_" << pic << "_" << (i + f) % spritesPerSheet << " "
+               << 50 + f * 10 << "\n";
+    }
+    manifest << "EndAnim\n";
+  }
+  for (int i = 0; i < config.numSounds; i++) {
+    const std::string name = "sound_" + std::to_string(i);
+    writeWav((assetsDir / "sounds" / (name + ".wav")).string(),
+             config.soundMs,
+             i);
+    manifest << "Sound," << name << ",assets/sounds/" << name << ".wav\n";
+  }
+
+  for (const std::string& lang : getLanguages(config.numLanguages)) {
+    std::ofstream translation(assetsDir / ("translation." + lang + ".txt"));
+    for (int i = 0; i < config.numStrings; i++) {
+      translation << "[Synthetic string number " << i << "] {" << lang
+                  << " translation of synthetic string number " << i << "}\n";
+    }
+  }
+}
+
+double zoneMs(const ZoneTotals& zones, const std::string& name) {
+  auto it = zones.find(name);
+  return it == zones.end() ? 0. : it->second.totalMs;
+}
+
+PhaseResult runPhase(
+    const std::string& name,
+    const std::function<void()>& fn,
+    const std::function<void(PhaseResult&, const ZoneTotals&)>& breakdown) {
+  Profiler::clear();
+  PhaseResult result;
+  result.name = name;
+  const AllocationCount allocsStart = getAllocationCount();
+  const uint64_t start = SDL_GetPerformanceCounter();
+  fn();
+  result.ms = countsToMs(SDL_GetPerformanceCounter() - start);
+  result.allocs = getAllocationCount() - allocsStart;
+  result.peakRssBytes = getPeakRssBytes();
+  breakdown(result, Profiler::getZoneTotals());
+  std::cerr << name << ": " << result.ms << " ms" << std::endl;
+  return result;
+}
+
+std::string toJson(const AssetBenchConfig& config,
+                   const std::vector<PhaseResult>& phases) {
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(3);
+  ss << "{\n  \"config\": {\"pictures\": " << config.numPictures
+     << ", \"sheetSize\": " << config.sheetSize
+     << ", \"spriteSize\": " << config.spriteSize
+     << ", \"anims\": " << config.numAnims
+     << ", \"framesPerAnim\": " << config.framesPerAnim
+     << ", \"sounds\": " << config.numSounds
+     << ", \"soundMs\": " << config.soundMs
+     << ", \"strings\": " << config.numStrings
+     << ", \"languages\": " << config.numLanguages
+     << "},\n  \"allocationSources\": \"" << ALLOCATION_SOURCES
+     << "\",\n  \"phases\": [";
+  for (size_t i = 0; i < phases.size(); i++) {
+    const PhaseResult& p = phases[i];
+    ss << (i == 0 ? "" : ",") << "\n    {\"name\": \"" << p.name
+       << "\", \"ms\": " << p.ms
+       << ", \"allocations\": " << p.allocs.allocations
+       << ", \"allocatedBytes\": " << p.allocs.bytes
+       << ", \"peakRssBytes\": " << p.peakRssBytes << ", \"breakdownMs\": {";
+    for (size_t j = 0; j < p.breakdownMs.size(); j++) {
+      ss << (j == 0 ? "" : ", ") << "\"" << p.breakdownMs[j].first
+         << "\": " << p.breakdownMs[j].second;
+    }
+    ss << "}}";
+  }
+  ss << "\n  ]\n}\n";
+  return ss.str();
+}
+
+int main(int argc, char** argv) {
+  countSdlAllocations();
+  AssetBenchConfig config;
+  std::map<std::string, int*> intArgs = {
+      {"--pictures", &config.numPictures},
+      {"--sheet-size", &config.sheetSize},
+      {"--sprite-size", &config.spriteSize},
+      {"--anims", &config.numAnims},
+      {"--frames", &config.framesPerAnim},
+      {"--sounds", &config.numSounds},
+      {"--sound-ms", &config.soundMs},
+      {"--strings", &config.numStrings},
+      {"--languages", &config.numLanguages},
+  };
+  std::map<std::string, std::string*> stringArgs = {
+      {"--font", &config.fontPath},
+      {"--dir", &config.dir},
+      {"--out", &config.outPath},
+      {"--trace", &config.tracePath},
+  };
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (intArgs.count(arg) && i + 1 < argc) {
+      *intArgs[arg] = std::stoi(argv[++i]);
+    } else if (stringArgs.count(arg) && i + 1 < argc) {
+      *stringArgs[arg] = argv[++i];
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--pictures <n>] [--sheet-size <px>] [--sprite-size <px>]"
+                   " [--anims <n>] [--frames <n>] [--sounds <n>] [--sound-ms "
+                   "<ms>] [--strings <n>] [--languages <n>] [--font <path>] "
+                   "[--dir <path>] [--out <path>] [--trace <path>]"
+                << std::endl;
+      return 1;
+    }
+  }
+  if (config.spriteSize <= 0 || config.sheetSize < config.spriteSize) {
+    std::cerr << "Error: --sprite-size must be in (0, --sheet-size]"
+              << std::endl;
+    return 1;
+  }
+#ifdef SDL2W_NO_PROFILING
+  std::cerr << "Warning: built with SDL2W_NO_PROFILING, phase breakdowns will "
+               "be empty"
+            << std::endl;
+#endif
+
+  // the manifest uses paths relative to the data dir, so resolve everything
+  // else before changing into it
+  namespace fs = std::filesystem;
+  for (std::string* path :
+       {&config.fontPath, &config.outPath, &config.tracePath}) {
+    if (!path->empty()) {
+      *path = fs::absolute(*path).string();
+    }
+  }
+
+  Logger::setLogLevel(WARN);
+  Window::init(WindowInitParams{.headless = true, .startupReport = false});
+  std::vector<PhaseResult> phases;
+  {
+    Store store;
+    Window window(store,
+                  {
+                      .mode = DrawMode::GPU,
+                      .title = "AssetBench",
+                      .w = 640,
+                      .h = 480,
+                      .x = 0,
+                      .y = 0,
+                      .renderW = 640,
+                      .renderH = 480,
+                      .headless = true,
+                      .presentMode = PresentMode::VSYNC_OFF,
+                  });
+
+    std::cerr << "Generating assets in " << config.dir << std::endl;
+    generateAssets(config);
+    fs::current_path(config.dir);
+    Profiler::setEnabled(true);
+
+    AssetLoader assetLoader(window.getDraw(), store);
+    phases.push_back(runPhase(
+        "loadAssetsFromFile",
+        [&]() {
+          assetLoader.loadAssetsFromFile(ASSET_FILE, "assets/assets.txt");
+        },
+        [](PhaseResult& result, const ZoneTotals& zones) {
+          const double pictureMs = zoneMs(zones, "AssetLoader::loadPicture");
+          const double sheetMs = zoneMs(zones, "AssetLoader::loadSpriteSheet");
+          const double soundMs = zoneMs(zones, "Store::storeSound") +
+                                 zoneMs(zones, "Store::storeMusic");
+          result.breakdownMs = {
+              {"parse",
+               zoneMs(zones, "AssetLoader::loadAssetFile") - pictureMs -
+                   sheetMs - soundMs},
+              {"decodePicture", zoneMs(zones, "AssetLoader::decodePicture")},
+              {"uploadPicture", zoneMs(zones, "AssetLoader::uploadPicture")},
+              {"spriteSheets", sheetMs},
+              {"sounds", soundMs},
+          };
+        }));
+
+    if (fs::exists(config.fontPath)) {
+      phases.push_back(runPhase(
+          "loadAndStoreFont",
+          [&]() { store.loadAndStoreFont("default", config.fontPath); },
+          [](PhaseResult&, const ZoneTotals&) {}));
+    } else {
+      std::cerr << "Font not found at " << config.fontPath
+                << ", skipping font phase" << std::endl;
+    }
+
+    L10n::setEnabled(true);
+    phases.push_back(runPhase(
+        "L10n::init",
+        [&]() { L10n::init(getLanguages(config.numLanguages)); },
+        [](PhaseResult& result, const ZoneTotals& zones) {
+          const double parseMs = zoneMs(zones, "L10n::loadLanguage");
+          result.breakdownMs = {
+              {"read", zoneMs(zones, "L10n::init") - parseMs},
+              {"parse", parseMs},
+          };
+        }));
+
+    const std::string json = toJson(config, phases);
+    std::cout << json;
+    if (!config.outPath.empty()) {
+      std::ofstream(config.outPath) << json;
+    }
+    if (!config.tracePath.empty()) {
+      Profiler::writeTrace(config.tracePath);
+    }
+    // the textures go with the headless renderer
+    store.clear();
+  }
+  Window::unInit();
+  return 0;
+}
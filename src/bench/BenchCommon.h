@@ -0,0 +1,116 @@
+// Helpers shared by the benchmark executables in this directory.
+//
+// This header replaces the global operator new/delete to count heap
+// allocations, so include it from exactly one source file per executable.
+// Call countSdlAllocations() before SDL is initialized to also count what
+// SDL and its satellite libraries allocate with SDL_malloc.  Libraries that
+// call malloc directly (libpng, zlib, codec libraries) are not counted.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace sdl2w::bench {
+
+// C++ allocations go through the operator new below, SDL's through the
+// functions installed by countSdlAllocations().
+inline std::atomic<uint64_t> numAllocations{0};
+inline std::atomic<uint64_t> numAllocatedBytes{0};
+// what the allocation counts cover, for the JSON output
+constexpr const char* ALLOCATION_SOURCES = "operator new, SDL_malloc";
+
+inline void countAllocation(size_t size) {
+  numAllocations.fetch_add(1, std::memory_order_relaxed);
+  numAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+inline void* countedMalloc(size_t size) {
+  countAllocation(size);
+  return std::malloc(size);
+}
+
+inline void* countedCalloc(size_t num, size_t size) {
+  countAllocation(num * size);
+  return std::calloc(num, size);
+}
+
+// a realloc counts as a new allocation of the new size
+inline void* countedRealloc(void* p, size_t size) {
+  countAllocation(size);
+  return std::realloc(p, size);
+}
+
+inline void countedFree(void* p) { std::free(p); }
+
+// SDL only accepts new memory functions while none of its allocations are
+// live, so call this first thing in main.
+inline void countSdlAllocations() {
+  if (SDL_SetMemoryFunctions(
+          countedMalloc, countedCalloc, countedRealloc, countedFree) != 0) {
+    std::cerr << "Warning: SDL allocations are not counted: "
+              << SDL_GetError() << std::endl;
+  }
+}
+
+struct AllocationCount {
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+};
+
+inline AllocationCount getAllocationCount() {
+  return {numAllocations.load(), numAllocatedBytes.load()};
+}
+
+inline AllocationCount operator-(const AllocationCount& a,
+                                 const AllocationCount& b) {
+  return {a.allocations - b.allocations, a.bytes - b.bytes};
+}
+
+inline double countsToMs(uint64_t counts) {
+  return static_cast<double>(counts) * 1000. /
+         static_cast<double>(SDL_GetPerformanceFrequency());
+}
+
+// High-water mark of the process' resident set, 0 where it isn't available.
+inline uint64_t getPeakRssBytes() {
+#ifdef _WIN32
+  return 0;
+#else
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+} // namespace sdl2w::bench
+
+void* operator new(size_t size) {
+  sdl2w::bench::countAllocation(size);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
@@ -0,0 +1,571 @@
+// RenderBench is a headless microbenchmark harness for the hot paths of
+// SDL2W: sprite and text drawing, primitives, animation updates and Store
+// lookups.  It renders with SDL's software renderer on the dummy video and
+// audio drivers, so it needs no display, and prints one JSON document with
+// ops/s, ns/op and heap allocations per op for every case.  The frame_mixed
+// cases draw the same frame through the software renderer and through Draw's
+// raster backend with every kernel set the CPU supports, and check that the
+// kernel sets draw identical frames that match the software renderer's
+// within Draw's documented tolerance; a mismatch makes the exit status 1.
+// The frame_sprites cases draw a sprite-heavy frame with the raster backend
+// on 1, 2, 4, ... up to every hardware thread.
+//
+//   make bench
+//   ./build/release/bench/RenderBench [--font <path>] [--filter <substr>]
+//                                     [--min-ms <ms>] [--out <path>]
+
+#include "../lib/Animation.h"
+#include "../lib/AnimationSystem.h"
+#include "../lib/Draw.h"
+#include "../lib/Logger.h"
+#include "../lib/SoftRaster.h"
+#include "../lib/Store.h"
+#include "../lib/Window.h"
+#include "../lib/WorkerPool.h"
+#include "BenchCommon.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+using namespace sdl2w;
+using namespace sdl2w::bench;
+
+constexpr int BENCH_W = 640;
+constexpr int BENCH_H = 480;
+constexpr int NUM_TEXTURES = 8;
+constexpr int NUM_STORE_SPRITES = 1000;
+constexpr int NUM_ANIMATIONS = 10000;
+// see Draw::setRasterBackend
+constexpr int RASTER_CHANNEL_TOLERANCE = 2;
+constexpr int RASTER_MAX_EDGE_PIXELS = BENCH_W * BENCH_H / 1000;
+
+struct BenchConfig {
+  std::string fontPath = "../example/assets/monofonto.ttf";
+  std::string filter;
+  std::string outPath;
+  double minMs = 250.;
+};
+
+struct BenchCase {
+  std::string name;
+  // ops performed by one call of run
+  int opsPerIteration;
+  std::function<void()> run;
+  // untimed, called before every iteration
+  std::function<void()> setup;
+  // untimed, called once after the last iteration; false fails the run
+  std::function<bool()> check;
+};
+
+struct BenchResult {
+  std::string name;
+  uint64_t ops = 0;
+  int iterations = 0;
+  double totalMs = 0.;
+  double nsPerOp = 0.;
+  double opsPerSec = 0.;
+  double allocsPerOp = 0.;
+  double bytesPerOp = 0.;
+};
+
+BenchResult runCase(const BenchCase& benchCase,
+                    SDL_Renderer* renderer,
+                    double minMs) {
+  // warm up caches, lazily created textures and allocator pools
+  if (benchCase.setup) {
+    benchCase.setup();
+  }
+  benchCase.run();
+  SDL_RenderFlush(renderer);
+
+  BenchResult result;
+  result.name = benchCase.name;
+  AllocationCount allocs;
+  while (result.iterations < 3 || result.totalMs < minMs) {
+    if (benchCase.setup) {
+      benchCase.setup();
+    }
+    const AllocationCount allocsStart = getAllocationCount();
+    const uint64_t start = SDL_GetPerformanceCounter();
+    benchCase.run();
+    // the renderer may batch commands, so make it do the work inside the
+    // timed region
+    SDL_RenderFlush(renderer);
+    result.totalMs += countsToMs(SDL_GetPerformanceCounter() - start);
+    const AllocationCount iterationAllocs =
+        getAllocationCount() - allocsStart;
+    allocs.allocations += iterationAllocs.allocations;
+    allocs.bytes += iterationAllocs.bytes;
+    result.ops += benchCase.opsPerIteration;
+    result.iterations++;
+  }
+
+  const double ops = static_cast<double>(result.ops);
+  result.nsPerOp = result.totalMs * 1000000. / ops;
+  result.opsPerSec = result.totalMs > 0. ? ops * 1000. / result.totalMs : 0.;
+  result.allocsPerOp = static_cast<double>(allocs.allocations) / ops;
+  result.bytesPerOp = static_cast<double>(allocs.bytes) / ops;
+  return result;
+}
+
+std::string toJson(const std::vector<BenchResult>& results,
+                   SDL_Renderer* renderer) {
+  SDL_RendererInfo info;
+  SDL_GetRendererInfo(renderer, &info);
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(3);
+  ss << "{\n  \"renderer\": \"" << info.name
+     << "\",\n  \"allocationSources\": \"" << ALLOCATION_SOURCES
+     << "\",\n  \"results\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult& r = results[i];
+    ss << (i == 0 ? "" : ",") << "\n    {\"name\": \"" << r.name
+       << "\", \"ops\": " << r.ops << ", \"iterations\": " << r.iterations
+       << ", \"totalMs\": " << r.totalMs << ", \"nsPerOp\": " << r.nsPerOp
+       << ", \"opsPerSec\": " << r.opsPerSec
+       << ", \"allocsPerOp\": " << r.allocsPerOp
+       << ", \"bytesPerOp\": " << r.bytesPerOp << "}";
+  }
+  ss << "\n  ]\n}\n";
+  return ss.str();
+}
+
+// the last presented frame, ARGB8888 without row padding
+std::vector<uint32_t> readFrame(Window& window) {
+  SDL_Surface* surf = window.getHeadlessSurface();
+  std::vector<uint32_t> pixels(static_cast<size_t>(surf->w) * surf->h);
+  for (int y = 0; y < surf->h; y++) {
+    const auto* row = reinterpret_cast<const uint32_t*>(
+        static_cast<const Uint8*>(surf->pixels) + y * surf->pitch);
+    std::copy(row, row + surf->w, pixels.begin() + y * surf->w);
+  }
+  return pixels;
+}
+
+// Compares frame with reference and logs how they differ.  Pixels with a
+// channel more than tolerance apart count as mismatched; up to maxMismatched
+// of them pass.
+bool compareFrames(const std::string& name,
+                   const std::vector<uint32_t>& frame,
+                   const std::string& referenceName,
+                   const std::vector<uint32_t>& reference,
+                   int tolerance,
+                   int maxMismatched) {
+  int maxDiff = 0;
+  int mismatched = 0;
+  for (size_t i = 0; i < frame.size(); i++) {
+    int pixelDiff = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      const int a = static_cast<int>((frame[i] >> shift) & 0xff);
+      const int b = static_cast<int>((reference[i] >> shift) & 0xff);
+      pixelDiff = std::max(pixelDiff, std::abs(a - b));
+    }
+    maxDiff = std::max(maxDiff, pixelDiff);
+    if (pixelDiff > tolerance) {
+      mismatched++;
+    }
+  }
+  if (mismatched > maxMismatched) {
+    std::cerr << "MISMATCH: " << name << " differs from " << referenceName
+              << " in " << mismatched << " pixels (max channel difference "
+              << maxDiff << ")" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+SDL_Texture* createSolidTexture(Draw& draw, int w, int h, Uint8 shade) {
+  SDL_Surface* surf =
+      SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+  SDL_FillRect(surf, nullptr, SDL_MapRGBA(surf->format, shade, 128, 64, 255));
+  SDL_Texture* tex = draw.createTexture(surf);
+  SDL_FreeSurface(surf);
+  return tex;
+}
+
+void createAssets(Draw& draw, Store& store) {
+  for (int i = 0; i < NUM_TEXTURES; i++) {
+    const std::string name = "bench_tex_" + std::to_string(i);
+    SDL_Texture* tex =
+        createSolidTexture(draw, 32, 32, static_cast<Uint8>(i * 30));
+    store.storeTexture(name, tex);
+    store.storeSprite(name,
+                      new Sprite{.name = name,
+                                 .renderable = {.tex = tex},
+                                 .w = 32,
+                                 .h = 32,
+                                 .spritesheetWidth = 32});
+  }
+  for (int i = 0; i < NUM_STORE_SPRITES; i++) {
+    const std::string name = "bench_lookup_" + std::to_string(i);
+    store.storeSprite(
+        name,
+        new Sprite{.name = name,
+                   .renderable = {.tex = store.getTexture("bench_tex_0")},
+                   .w = 32,
+                   .h = 32,
+                   .spritesheetWidth = 32});
+  }
+  AnimationDefinition& def = store.storeAnimationDefinition("bench_anim", true);
+  for (int i = 0; i < NUM_TEXTURES; i++) {
+    def.addSprite("bench_tex_" + std::to_string(i), 100 + i * 10);
+  }
+}
+
+std::vector<BenchCase> createCases(Window& window, bool hasFont) {
+  Draw& draw = window.getDraw();
+  Store& store = window.getStore();
+  std::vector<BenchCase> cases;
+
+  std::vector<const Sprite*> sprites;
+  for (int i = 0; i < NUM_TEXTURES; i++) {
+    sprites.push_back(&store.getSprite("bench_tex_" + std::to_string(i)));
+  }
+  auto posX = [](int i) { return (i * 37) % BENCH_W; };
+  auto posY = [](int i) { return (i * 53) % BENCH_H; };
+
+  cases.push_back({"sprite_same_texture", 1000, [=, &draw]() {
+                     for (int i = 0; i < 1000; i++) {
+                       draw.drawSprite(*sprites[0],
+                                       RenderableParams{.scale = {1., 1.},
+                                                        .x = posX(i),
+                                                        .y = posY(i)});
+                     }
+                   }});
+  cases.push_back({"sprite_mixed_textures", 1000, [=, &draw]() {
+                     for (int i = 0; i < 1000; i++) {
+                       draw.drawSprite(*sprites[i % NUM_TEXTURES],
+                                       RenderableParams{.scale = {1., 1.},
+                                                        .x = posX(i),
+                                                        .y = posY(i)});
+                     }
+                   }});
+  cases.push_back({"sprite_rotated", 1000, [=, &draw]() {
+                     for (int i = 0; i < 1000; i++) {
+                       draw.drawSprite(
+                           *sprites[0],
+                           RenderableParamsEx{.scale = {1., 1.},
+                                              .angleDeg = (i * 7) % 360 * 1.,
+                                              .x = posX(i),
+                                              .y = posY(i)});
+                     }
+                   }});
+  cases.push_back({"sprite_scaled", 1000, [=, &draw]() {
+                     for (int i = 0; i < 1000; i++) {
+                       draw.drawSprite(*sprites[0],
+                                       RenderableParams{.scale = {2.5, 2.5},
+                                                        .x = posX(i),
+                                                        .y = posY(i)});
+                     }
+                   }});
+
+  if (hasFont) {
+    cases.push_back({"text_cache_hit", 1000, [=, &draw]() {
+                       for (int i = 0; i < 1000; i++) {
+                         draw.drawText("Benchmark text",
+                                       RenderTextParams{.x = posX(i),
+                                                        .y = posY(i),
+                                                        .color = {255,
+                                                                  255,
+                                                                  255,
+                                                                  255}});
+                       }
+                     }});
+    auto missCounter = std::make_shared<int>(0);
+    cases.push_back({"text_cache_miss",
+                     100,
+                     [=, &draw]() {
+                       for (int i = 0; i < 100; i++) {
+                         draw.drawText("Miss " +
+                                           std::to_string((*missCounter)++),
+                                       RenderTextParams{.x = posX(i),
+                                                        .y = posY(i),
+                                                        .color = {255,
+                                                                  255,
+                                                                  255,
+                                                                  255}});
+                       }
+                     },
+                     [&store]() { store.dynamicTextures.clear(); }});
+  }
+
+  cases.push_back({"primitive_rect", 1000, [=, &draw]() {
+                     for (int i = 0; i < 1000; i++) {
+                       draw.drawRect(
+                           posX(i), posY(i), 24, 16, {200, 0, 0, 255});
+                     }
+                   }});
+  cases.push_back({"primitive_line", 1000, [=, &draw]() {
+                     for (int i = 0; i < 1000; i++) {
+                       draw.drawLine({posX(i), posY(i)},
+                                     {posX(i + 1), posY(i + 1)},
+                                     1,
+                                     {0, 200, 0, 255});
+                     }
+                   }});
+  cases.push_back({"primitive_circle", 1000, [=, &draw]() {
+                     for (int i = 0; i < 1000; i++) {
+                       draw.drawCircle(posX(i), posY(i), 12, {0, 0, 200, 255});
+                     }
+                   }});
+  // one frame of 100 sprites, composited through the intermediate texture or
+  // drawn straight to the backbuffer
+  for (const bool direct : {false, true}) {
+    cases.push_back({direct ? "frame_direct_present" : "frame_intermediate",
+                     1,
+                     [=, &draw]() {
+                       for (int i = 0; i < 100; i++) {
+                         draw.drawSprite(*sprites[i % NUM_TEXTURES],
+                                         RenderableParams{.scale = {1., 1.},
+                                                          .x = posX(i),
+                                                          .y = posY(i)});
+                       }
+                       draw.renderIntermediate();
+                     },
+                     [=, &draw]() {
+                       draw.setDirectPresent(direct);
+                       draw.clearScreen();
+                     }});
+  }
+  // sprites (some rotated or scaled), translucent rects, lines and circles
+  auto drawMixedFrame = [=, &draw]() {
+    for (int i = 0; i < 200; i++) {
+      draw.drawSprite(
+          *sprites[i % NUM_TEXTURES],
+          RenderableParamsEx{
+              .scale = i % 4 == 2 ? std::make_pair(2.5, 2.5)
+                                  : std::make_pair(1., 1.),
+              .angleDeg = i % 4 == 1 ? (i * 7) % 360 * 1. : 0.,
+              .x = posX(i),
+              .y = posY(i)});
+    }
+    for (int i = 0; i < 50; i++) {
+      draw.drawRect(posX(i), posY(i), 24, 16, {40, 200, 80, 160});
+    }
+    for (int i = 0; i < 20; i++) {
+      draw.drawLine({posX(i), posY(i)},
+                    {posX(i + 1), posY(i + 1)},
+                    1 + i % 3,
+                    {0, 200, 0, 255});
+    }
+    for (int i = 0; i < 10; i++) {
+      draw.drawCircle(posX(i), posY(i), 12, {0, 0, 200, 255}, i % 2 == 0);
+    }
+    draw.renderIntermediate();
+  };
+  // frames the raster cases are checked against, empty when filtered out
+  auto sdlFrame = std::make_shared<std::vector<uint32_t>>();
+  auto scalarFrame = std::make_shared<std::vector<uint32_t>>();
+  cases.push_back({"frame_mixed_sdl",
+                   1,
+                   drawMixedFrame,
+                   [&draw]() {
+                     draw.setDirectPresent(false);
+                     draw.setRasterBackend(false);
+                     draw.clearScreen();
+                   },
+                   [=, &window]() {
+                     *sdlFrame = readFrame(window);
+                     return true;
+                   }});
+  for (const RasterIsa isa : {RASTER_SCALAR, RASTER_SSE2, RASTER_AVX2}) {
+    if (!SoftRaster::isIsaSupported(isa)) {
+      continue;
+    }
+    const std::string name =
+        std::string("frame_mixed_raster_") + SoftRaster::getIsaName(isa);
+    cases.push_back(
+        {name,
+         1,
+         drawMixedFrame,
+         [=, &draw]() {
+           draw.setDirectPresent(false);
+           SoftRaster::setIsa(isa);
+           draw.setRasterThreads(1);
+           draw.setRasterBackend(true);
+           draw.clearScreen();
+         },
+         [=, &window]() {
+           const std::vector<uint32_t> frame = readFrame(window);
+           bool ok = true;
+           if (isa == RASTER_SCALAR) {
+             *scalarFrame = frame;
+             if (!sdlFrame->empty()) {
+               ok = compareFrames(name,
+                                  frame,
+                                  "frame_mixed_sdl",
+                                  *sdlFrame,
+                                  RASTER_CHANNEL_TOLERANCE,
+                                  RASTER_MAX_EDGE_PIXELS);
+             }
+           } else if (!scalarFrame->empty()) {
+             // every kernel set computes the same pixels
+             ok = compareFrames(
+                 name, frame, "frame_mixed_raster_scalar", *scalarFrame, 0, 0);
+           }
+           return ok;
+         }});
+  }
+  // with the fastest kernels, which the last case above left selected
+  auto drawSpriteFrame = [=, &draw]() {
+    for (int i = 0; i < 2000; i++) {
+      draw.drawSprite(
+          *sprites[i % NUM_TEXTURES],
+          RenderableParamsEx{
+              .scale = i % 4 == 0 ? std::make_pair(2., 2.)
+                                  : std::make_pair(1., 1.),
+              .angleDeg = i % 8 == 1 ? (i * 7) % 360 * 1. : 0.,
+              .x = posX(i),
+              .y = posY(i)});
+    }
+    draw.renderIntermediate();
+  };
+  const int hardwareThreads = WorkerPool::getHardwareThreads();
+  for (int threads = 1; threads <= hardwareThreads; threads *= 2) {
+    // the last step is every hardware thread, even if that isn't a power of 2
+    const int numThreads =
+        threads * 2 > hardwareThreads ? hardwareThreads : threads;
+    cases.push_back({"frame_sprites_raster_t" + std::to_string(numThreads),
+                     2000,
+                     drawSpriteFrame,
+                     [=, &draw]() {
+                       draw.setDirectPresent(false);
+                       draw.setRasterThreads(numThreads);
+                       draw.setRasterBackend(true);
+                       draw.clearScreen();
+                     }});
+  }
+
+  auto anims = std::make_shared<std::vector<Animation>>();
+  for (int i = 0; i < NUM_ANIMATIONS; i++) {
+    anims->push_back(store.createAnimation("bench_anim"));
+  }
+  cases.push_back({"animation_update", NUM_ANIMATIONS, [=]() {
+                     for (Animation& anim : *anims) {
+                       anim.update(16);
+                     }
+                   }});
+  auto animSystem = std::make_shared<AnimationSystem>(store);
+  for (int i = 0; i < NUM_ANIMATIONS; i++) {
+    animSystem->create("bench_anim");
+  }
+  cases.push_back({"animation_system_update", NUM_ANIMATIONS, [=]() {
+                     animSystem->update(16);
+                   }});
+
+  auto lookupNames = std::make_shared<std::vector<std::string>>();
+  for (int i = 0; i < NUM_STORE_SPRITES; i++) {
+    lookupNames->push_back("bench_lookup_" + std::to_string(i));
+  }
+  cases.push_back({"store_get_sprite", NUM_STORE_SPRITES, [=, &store]() {
+                     int sum = 0;
+                     for (const std::string& name : *lookupNames) {
+                       sum += store.getSprite(name).w;
+                     }
+                     // keep the lookups from being optimized out
+                     if (sum == 0) {
+                       std::cerr << "unexpected sprite sizes" << std::endl;
+                     }
+                   }});
+  cases.push_back({"store_get_texture", 1000, [&store]() {
+                     for (int i = 0; i < 1000; i++) {
+                       if (store.getTexture("bench_tex_3") == nullptr) {
+                         std::cerr << "missing texture" << std::endl;
+                       }
+                     }
+                   }});
+
+  return cases;
+}
+
+int main(int argc, char** argv) {
+  countSdlAllocations();
+  BenchConfig config;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--font" && i + 1 < argc) {
+      config.fontPath = argv[++i];
+    } else if (arg == "--filter" && i + 1 < argc) {
+      config.filter = argv[++i];
+    } else if (arg == "--min-ms" && i + 1 < argc) {
+      config.minMs = std::stod(argv[++i]);
+    } else if (arg == "--out" && i + 1 < argc) {
+      config.outPath = argv[++i];
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--font <path>] [--filter <substring>] [--min-ms <ms>] "
+                   "[--out <path>]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  // keep stdout for the JSON
+  Logger::setLogLevel(WARN);
+  Window::init(WindowInitParams{.headless = true, .startupReport = false});
+  std::vector<BenchResult> results;
+  bool mismatch = false;
+  {
+    Store store;
+    Window window(store,
+                  {
+                      .mode = DrawMode::GPU,
+                      .title = "RenderBench",
+                      .w = BENCH_W,
+                      .h = BENCH_H,
+                      .x = 0,
+                      .y = 0,
+                      .renderW = BENCH_W,
+                      .renderH = BENCH_H,
+                      .headless = true,
+                      .presentMode = PresentMode::VSYNC_OFF,
+                  });
+
+    const bool hasFont = std::filesystem::exists(config.fontPath);
+    if (hasFont) {
+      store.loadAndStoreFont("default", config.fontPath);
+    } else {
+      LOG(WARN) << "Font not found at " << config.fontPath
+                << ", skipping text cases" << LOG_ENDL;
+    }
+    createAssets(window.getDraw(), store);
+
+    SDL_Renderer* renderer = window.getDraw().getSdlRenderer();
+    for (const BenchCase& benchCase : createCases(window, hasFont)) {
+      if (!config.filter.empty() &&
+          benchCase.name.find(config.filter) == std::string::npos) {
+        continue;
+      }
+      results.push_back(runCase(benchCase, renderer, config.minMs));
+      std::cerr << results.back().name << ": " << results.back().nsPerOp
+                << " ns/op" << std::endl;
+      if (benchCase.check && !benchCase.check()) {
+        mismatch = true;
+      }
+    }
+
+    const std::string json = toJson(results, renderer);
+    std::cout << json;
+    if (!config.outPath.empty()) {
+      std::ofstream(config.outPath) << json;
+    }
+    // the textures go with the headless renderer
+    store.clear();
+  }
+  Window::unInit();
+  return mismatch ? 1 : 0;
+}
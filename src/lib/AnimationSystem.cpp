@@ -0,0 +1,201 @@
+#include "AnimationSystem.h"
+#include "Animation.h"
+#include "Draw.h"
+#include "Logger.h"
+#include "Store.h"
+#include <algorithm>
+#include <climits>
+
+namespace sdl2w {
+
+AnimationSystem::AnimationSystem(Store& storeA)
+    : store(storeA), minLoopDuration(INT_MAX) {}
+
+AnimationSystem::~AnimationSystem() {}
+
+int AnimationSystem::getTableId(std::string_view animName) {
+  const std::string nameStr(animName);
+  auto it = tableIds.find(nameStr);
+  if (it != tableIds.end()) {
+    return it->second;
+  }
+
+  const AnimationDefinition& def = store.getAnimationDefinition(nameStr);
+  AnimTable table;
+  table.name = def.name;
+  table.frameOffset = static_cast<int>(frameEnds.size());
+  table.frameCount = static_cast<int>(def.sprites.size());
+  for (const auto& spriteDef : def.sprites) {
+    table.totalDuration += spriteDef.duration;
+    frameEnds.push_back(table.totalDuration);
+    frameSprites.push_back(&store.getSprite(spriteDef.name));
+  }
+  // matches Animation::update, which never wraps an empty animation
+  table.loop = def.loop && table.totalDuration > 0;
+  if (table.loop) {
+    minLoopDuration = std::min(minLoopDuration, table.totalDuration);
+  }
+
+  const int id = static_cast<int>(tables.size());
+  tables.push_back(table);
+  tableIds[nameStr] = id;
+  return id;
+}
+
+AnimationSystem::Handle AnimationSystem::create(std::string_view animName,
+                                                bool flippedA) {
+  const int table = getTableId(animName);
+  Handle id;
+  if (!freeIds.empty()) {
+    id = freeIds.back();
+    freeIds.pop_back();
+  } else {
+    id = static_cast<Handle>(t.size());
+    t.push_back(0);
+    spriteIndex.push_back(0);
+    tableId.push_back(0);
+    totalDuration.push_back(0);
+    loop.push_back(0);
+    flipped.push_back(0);
+    alive.push_back(0);
+  }
+  t[id] = 0;
+  spriteIndex[id] = 0;
+  tableId[id] = table;
+  totalDuration[id] = tables[table].totalDuration;
+  loop[id] = tables[table].loop ? 1 : 0;
+  flipped[id] = flippedA ? 1 : 0;
+  alive[id] = 1;
+  numAlive++;
+  return id;
+}
+
+void AnimationSystem::destroy(Handle id) {
+  if (!isValid(id)) {
+    LOG(WARN) << "[sdl2w] Cannot destroy invalid animation handle: " << id
+              << Logger::endl;
+    return;
+  }
+  // dead slots stay in the arrays so update() never branches on them; stop
+  // them looping so their time can't affect the wrap fast path
+  alive[id] = 0;
+  loop[id] = 0;
+  totalDuration[id] = 0;
+  t[id] = 0;
+  freeIds.push_back(id);
+  numAlive--;
+}
+
+void AnimationSystem::clear() {
+  t.clear();
+  spriteIndex.clear();
+  tableId.clear();
+  totalDuration.clear();
+  loop.clear();
+  flipped.clear();
+  alive.clear();
+  freeIds.clear();
+  numAlive = 0;
+}
+
+void AnimationSystem::reserve(int n) {
+  t.reserve(n);
+  spriteIndex.reserve(n);
+  tableId.reserve(n);
+  totalDuration.reserve(n);
+  loop.reserve(n);
+  flipped.reserve(n);
+  alive.reserve(n);
+}
+
+bool AnimationSystem::isValid(Handle id) const {
+  return id >= 0 && id < static_cast<Handle>(alive.size()) && alive[id];
+}
+
+void AnimationSystem::start(Handle id) {
+  t[id] = 0;
+  spriteIndex[id] = 0;
+}
+
+void AnimationSystem::setFlipped(Handle id, bool flippedA) {
+  flipped[id] = flippedA ? 1 : 0;
+}
+
+bool AnimationSystem::isDone(Handle id) const {
+  return !loop[id] && t[id] >= totalDuration[id];
+}
+
+const std::string& AnimationSystem::getName(Handle id) const {
+  return tables[tableId[id]].name;
+}
+
+const Sprite& AnimationSystem::getCurrentSprite(Handle id) const {
+  const AnimTable& table = tables[tableId[id]];
+  if (table.frameCount == 0) {
+    return *Animation::staticDefaultSprite;
+  }
+  return *frameSprites[table.frameOffset + spriteIndex[id]];
+}
+
+void AnimationSystem::setParallel(int numThreads, int threshold) {
+  parallelThreshold = threshold;
+  if (numThreads == 1) {
+    pool.reset();
+  } else {
+    pool = std::make_unique<WorkerPool>(numThreads);
+  }
+}
+
+void AnimationSystem::updateRange(int begin, int end, int dt) {
+  int* tp = t.data();
+  int* indexp = spriteIndex.data();
+  const int* totalp = totalDuration.data();
+  const int* tablep = tableId.data();
+  const uint8_t* loopp = loop.data();
+
+  if (dt < minLoopDuration) {
+    // Every looping animation has t <= totalDuration, so with
+    // dt < totalDuration a single subtraction is the same as the modulo in
+    // Animation::update.  Branchless so it vectorizes.
+    for (int i = begin; i < end; i++) {
+      const int nt = tp[i] + dt;
+      const int mask = -static_cast<int>(loopp[i] & (nt > totalp[i]));
+      tp[i] = nt - (totalp[i] & mask);
+    }
+  } else {
+    for (int i = begin; i < end; i++) {
+      tp[i] += dt;
+      if (loopp[i] && tp[i] > totalp[i]) {
+        tp[i] = tp[i] % totalp[i];
+      }
+    }
+  }
+
+  const int* endsp = frameEnds.data();
+  for (int i = begin; i < end; i++) {
+    const AnimTable& table = tables[tablep[i]];
+    const int* ends = endsp + table.frameOffset;
+    const int lastFrame = table.frameCount - 1;
+    const int ti = tp[i];
+    int index = 0;
+    for (int k = 0; k < lastFrame; k++) {
+      index += ti >= ends[k];
+    }
+    indexp[i] = index;
+  }
+}
+
+void AnimationSystem::update(int dt) {
+  const int n = static_cast<int>(t.size());
+  if (pool != nullptr && n >= parallelThreshold) {
+    pool->parallelFor(n,
+                      parallelThreshold / pool->getNumThreads(),
+                      [this, dt](int begin, int end) {
+                        updateRange(begin, end, dt);
+                      });
+  } else {
+    updateRange(0, n, dt);
+  }
+}
+
+} // namespace sdl2w
@@ -0,0 +1,89 @@
+// An AnimationSystem owns the state of many animations at once and advances
+// all of them with a single update(dt).  State is kept in structure-of-arrays
+// form (one vector per field) so the timing pass is a flat loop over ints that
+// the compiler can vectorize, and large populations can be split across a
+// WorkerPool.
+//
+// Like Animation, the system keeps pointers to Sprites owned by the Store it
+// was created from, so it must not outlive a Store::clear().
+
+#pragma once
+
+#include "WorkerPool.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sdl2w {
+struct Sprite;
+class Store;
+
+class AnimationSystem {
+  // Frame timing for one AnimationDefinition, flattened into frameEnds and
+  // frameSprites at [frameOffset, frameOffset + frameCount).
+  struct AnimTable {
+    std::string name;
+    int frameOffset = 0;
+    int frameCount = 0;
+    int totalDuration = 0;
+    bool loop = false;
+  };
+
+  Store& store;
+  std::vector<AnimTable> tables;
+  std::unordered_map<std::string, int> tableIds;
+  std::vector<int> frameEnds;
+  std::vector<const Sprite*> frameSprites;
+
+  // per-animation state
+  std::vector<int> t;
+  std::vector<int> spriteIndex;
+  std::vector<int> tableId;
+  std::vector<int> totalDuration;
+  std::vector<uint8_t> loop;
+  std::vector<uint8_t> flipped;
+  std::vector<uint8_t> alive;
+  std::vector<int> freeIds;
+  int numAlive = 0;
+  int minLoopDuration = 0;
+
+  std::unique_ptr<WorkerPool> pool;
+  int parallelThreshold = 8192;
+
+  int getTableId(std::string_view animName);
+  void updateRange(int begin, int end, int dt);
+
+public:
+  using Handle = int;
+  static constexpr Handle INVALID_HANDLE = -1;
+
+  AnimationSystem(Store& storeA);
+  ~AnimationSystem();
+
+  Handle create(std::string_view animName, bool flipped = false);
+  void destroy(Handle id);
+  void clear();
+  void reserve(int n);
+  bool isValid(Handle id) const;
+  int size() const { return numAlive; }
+
+  void start(Handle id);
+  void setFlipped(Handle id, bool flippedA);
+  bool isFlipped(Handle id) const { return flipped[id] != 0; }
+  bool isDone(Handle id) const;
+  int getT(Handle id) const { return t[id]; }
+  int getSpriteIndex(Handle id) const { return spriteIndex[id]; }
+  const std::string& getName(Handle id) const;
+  const Sprite& getCurrentSprite(Handle id) const;
+
+  // Populations of at least `threshold` animations are split across
+  // `numThreads` threads (<= 0 for one per hardware thread, 1 to disable).
+  void setParallel(int numThreads, int threshold = 8192);
+
+  void update(int dt);
+};
+
+} // namespace sdl2w
@@ -2,6 +2,7 @@
 #include "Defines.h"
 #include "Draw.h"
 #include "Logger.h"
+#include "Profiler.h"
 #include <fstream>
 #include <map>
 #include <sstream>
@@ -166,8 +167,13 @@ void AssetLoader::initFs() {
 }
 
 void AssetLoader::loadPicture(std::string_view name, std::string_view path) {
+  SDL2W_ZONE("AssetLoader::loadPicture");
   const std::string pathStr(path);
-  SDL_Surface* loadedImage = IMG_Load(pathStr.c_str());
+  SDL_Surface* loadedImage = nullptr;
+  {
+    SDL2W_ZONE("AssetLoader::decodePicture");
+    loadedImage = IMG_Load(pathStr.c_str());
+  }
 
   if (loadedImage == nullptr) {
     LOG_LINE(ERROR) << "[sdl2w] ERROR Failed to load image: " << name << " ("
@@ -176,7 +182,11 @@ void AssetLoader::loadPicture(std::string_view name, std::string_view path) {
   }
   picturePathToAlias[pathStr] = std::string(name);
 
-  SDL_Texture* tex = draw.createTexture(loadedImage);
+  SDL_Texture* tex = nullptr;
+  {
+    SDL2W_ZONE("AssetLoader::uploadPicture");
+    tex = draw.createTexture(loadedImage);
+  }
   store.storeTexture(name, tex);
   SDL_FreeSurface(loadedImage);
   loadSprite(name, tex, false);
@@ -222,6 +232,7 @@ void AssetLoader::loadSpriteSheet(std::string_view pictureName,
                                   int n,
                                   int w,
                                   int h) {
+  SDL2W_ZONE("AssetLoader::loadSpriteSheet");
   const std::string pictureStr(pictureName);
   Sprite& sprite = store.getSprite(pictureStr);
 
@@ -405,6 +416,7 @@ void AssetLoader::loadSoundAssetsFromFile(std::string_view path) {
 }
 
 void AssetLoader::loadAssetFile(std::string_view path) {
+  SDL2W_ZONE("AssetLoader::loadAssetFile");
   const std::string pathStr(path);
   LOG(DEBUG) << "[sdl2w] Loading asset file "
              << (std::string(ASSETS_PREFIX) + pathStr) << Logger::endl;
@@ -1,11 +1,21 @@
 #include "Draw.h"
+#include "AnimationSystem.h"
 #include "Defines.h"
 #include "Logger.h"
+#include "Profiler.h"
+#include "SoftRaster.h"
 #include "Store.h"
+#include "WorkerPool.h"
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
 
 #if __has_include(<SDL.h>)
 #include <SDL.h>
@@ -28,6 +38,280 @@
 namespace sdl2w {
 
 // https://gist.github.com/Gumichan01/332c26f6197a432db91cc4327fcabb1c
+namespace {
+constexpr double PI = 3.14159265358979323846;
+// edge length of the tiles raster frames are split into across threads
+constexpr int RASTER_TILE_SIZE = 64;
+// what a draw costs on top of its pixels, in pixels, when balancing tiles
+constexpr int64_t RASTER_DRAW_COST = 64;
+// dirty-rect mode merges damage past this many rects
+constexpr size_t MAX_DAMAGE_RECTS = 8;
+// how far ahead dirty-rect mode looks for a command after a mismatch, so an
+// inserted or removed draw doesn't damage every draw after it
+constexpr size_t DAMAGE_RESYNC_WINDOW = 16;
+
+std::string getTextKey(std::string_view text, const RenderTextParams& params) {
+  std::stringstream keyStream;
+  keyStream << text << params.fontSize << params.fontName << params.color.r
+            << params.color.g << params.color.b;
+  return keyStream.str();
+}
+} // namespace
+
+enum DrawCommandType {
+  CMD_TEXTURE,
+  CMD_RECT,
+  CMD_QUAD,
+  CMD_LINE,
+  CMD_CIRCLE,
+};
+
+// One SDL submission in render target coordinates, after the camera and
+// culling.  Dirty-rect mode and the tiled raster backend record these
+// instead of executing them.
+struct DrawCommand {
+  DrawCommandType type = CMD_TEXTURE;
+  SDL_Texture* tex = nullptr;
+  SDL_Rect clip = {0, 0, 0, 0};
+  // texture destination, or the rect of CMD_RECT
+  SDL_Rect dst = {0, 0, 0, 0};
+  double angleDeg = 0.;
+  SDL_Color color = {0, 0, 0, 0};
+  // quad corners, line end points ([0] and [1]) or circle center ([0])
+  Sint16 vx[4] = {0, 0, 0, 0};
+  Sint16 vy[4] = {0, 0, 0, 0};
+  // line width or circle radius
+  int size = 0;
+  Uint8 alpha = 255;
+  bool flipped = false;
+  bool premultiplied = false;
+  bool filled = false;
+  // area of the target the command can touch, only set when recorded
+  SDL_Rect bounds = {0, 0, 0, 0};
+};
+
+// Set while the raster backend draws frames in tiles (see
+// Draw::setRasterThreads).  Draws to the frame are recorded and drawn when it
+// is uploaded: each tile by one thread, going through the draws that touch it
+// in submission order.
+struct RasterTileState {
+  struct Recorded {
+    DrawCommand cmd;
+    // the texture's image, looked up on the main thread
+    const RasterImage* image = nullptr;
+  };
+  std::unique_ptr<WorkerPool> pool;
+  // the setRasterThreads() count the pool was created for
+  int numThreads = 0;
+  std::vector<Recorded> commands;
+  // per tile, row by row: indices into commands, and a rough cost in pixels
+  std::vector<std::vector<int>> bins;
+  std::vector<int64_t> costs;
+  std::vector<int> order;
+  // per thread: the tiles it draws, and their summed cost
+  std::vector<std::vector<int>> jobs;
+  std::vector<int64_t> jobCosts;
+  // the frame has not been cleared yet; each tile clears its own pixels
+  bool clearPending = true;
+};
+
+struct DirtyRectState {
+  std::vector<DrawCommand> commands;
+  std::vector<DrawCommand> prevCommands;
+  // textures rendered into this frame; draws of them are damaged even if the
+  // command itself is unchanged
+  std::unordered_set<SDL_Texture*> modifiedTextures;
+  double fullRedrawThreshold = 0.5;
+  bool fullRedraw = true;
+  // the backbuffer has to be recomposited as a whole, not only the damage
+  bool compositeAll = true;
+  bool flushed = false;
+  bool hasDamage = false;
+  // disjoint rects, at most MAX_DAMAGE_RECTS
+  std::vector<SDL_Rect> damage;
+};
+
+namespace {
+bool isSameCommand(const DrawCommand& a, const DrawCommand& b) {
+  if (a.type != b.type || a.tex != b.tex || a.angleDeg != b.angleDeg ||
+      a.size != b.size || a.alpha != b.alpha || a.flipped != b.flipped ||
+      a.premultiplied != b.premultiplied || a.filled != b.filled ||
+      a.color.r != b.color.r || a.color.g != b.color.g ||
+      a.color.b != b.color.b || a.color.a != b.color.a) {
+    return false;
+  }
+  for (int i = 0; i < 4; i++) {
+    if (a.vx[i] != b.vx[i] || a.vy[i] != b.vy[i]) {
+      return false;
+    }
+  }
+  return a.clip.x == b.clip.x && a.clip.y == b.clip.y &&
+         a.clip.w == b.clip.w && a.clip.h == b.clip.h && a.dst.x == b.dst.x &&
+         a.dst.y == b.dst.y && a.dst.w == b.dst.w && a.dst.h == b.dst.h;
+}
+
+bool overlaps(const SDL_Rect& a, const SDL_Rect& b) {
+  return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h &&
+         b.y < a.y + a.h;
+}
+
+SDL_Rect getBoundingRect(const SDL_Rect& a, const SDL_Rect& b) {
+  const int x0 = std::min(a.x, b.x);
+  const int y0 = std::min(a.y, b.y);
+  const int x1 = std::max(a.x + a.w, b.x + b.w);
+  const int y1 = std::max(a.y + a.h, b.y + b.h);
+  return {x0, y0, x1 - x0, y1 - y0};
+}
+
+int64_t getArea(const SDL_Rect& r) { return static_cast<int64_t>(r.w) * r.h; }
+
+// Adds r to the damage, merging it with the rects it overlaps.  Past
+// MAX_DAMAGE_RECTS it is merged with the rect whose bounds grow the least.
+void addToDamage(DirtyRectState& state, const SDL_Rect& r) {
+  if (r.w <= 0 || r.h <= 0) {
+    return;
+  }
+  std::vector<SDL_Rect>& damage = state.damage;
+  SDL_Rect merged = r;
+  // a merged rect can reach rects the original didn't, so start over
+  for (size_t i = 0; i < damage.size();) {
+    if (overlaps(damage[i], merged)) {
+      merged = getBoundingRect(merged, damage[i]);
+      damage[i] = damage.back();
+      damage.pop_back();
+      i = 0;
+    } else {
+      i++;
+    }
+  }
+  if (damage.size() >= MAX_DAMAGE_RECTS) {
+    size_t best = 0;
+    int64_t bestGrowth = std::numeric_limits<int64_t>::max();
+    for (size_t i = 0; i < damage.size(); i++) {
+      const int64_t growth = getArea(getBoundingRect(merged, damage[i])) -
+                             getArea(damage[i]) - getArea(merged);
+      if (growth < bestGrowth) {
+        best = i;
+        bestGrowth = growth;
+      }
+    }
+    merged = getBoundingRect(merged, damage[best]);
+    damage[best] = damage.back();
+    damage.pop_back();
+    addToDamage(state, merged);
+    return;
+  }
+  damage.push_back(merged);
+  state.hasDamage = true;
+}
+
+// The part of a width x height target cmd can touch, with one pixel of slack
+// for rounding and antialiasing.
+SDL_Rect getCommandBounds(const DrawCommand& cmd, int width, int height) {
+  double x0 = 0.;
+  double y0 = 0.;
+  double x1 = 0.;
+  double y1 = 0.;
+  switch (cmd.type) {
+  case CMD_TEXTURE: {
+    const double halfW = std::abs(cmd.dst.w) / 2.;
+    const double halfH = std::abs(cmd.dst.h) / 2.;
+    double extentX = halfW;
+    double extentY = halfH;
+    if (cmd.angleDeg != 0.) {
+      const double rad = cmd.angleDeg * PI / 180.;
+      const double c = std::abs(std::cos(rad));
+      const double s = std::abs(std::sin(rad));
+      extentX = halfW * c + halfH * s;
+      extentY = halfW * s + halfH * c;
+    }
+    const double centerX = cmd.dst.x + cmd.dst.w / 2.;
+    const double centerY = cmd.dst.y + cmd.dst.h / 2.;
+    x0 = centerX - extentX;
+    y0 = centerY - extentY;
+    x1 = centerX + extentX;
+    y1 = centerY + extentY;
+    break;
+  }
+  case CMD_RECT:
+    x0 = std::min(cmd.dst.x, cmd.dst.x + cmd.dst.w);
+    y0 = std::min(cmd.dst.y, cmd.dst.y + cmd.dst.h);
+    x1 = std::max(cmd.dst.x, cmd.dst.x + cmd.dst.w);
+    y1 = std::max(cmd.dst.y, cmd.dst.y + cmd.dst.h);
+    break;
+  case CMD_QUAD:
+    x0 = *std::min_element(cmd.vx, cmd.vx + 4);
+    y0 = *std::min_element(cmd.vy, cmd.vy + 4);
+    x1 = *std::max_element(cmd.vx, cmd.vx + 4);
+    y1 = *std::max_element(cmd.vy, cmd.vy + 4);
+    break;
+  case CMD_LINE:
+    x0 = std::min(cmd.vx[0], cmd.vx[1]) - cmd.size / 2.;
+    y0 = std::min(cmd.vy[0], cmd.vy[1]) - cmd.size / 2.;
+    x1 = std::max(cmd.vx[0], cmd.vx[1]) + cmd.size / 2.;
+    y1 = std::max(cmd.vy[0], cmd.vy[1]) + cmd.size / 2.;
+    break;
+  case CMD_CIRCLE:
+    x0 = cmd.vx[0] - cmd.size;
+    y0 = cmd.vy[0] - cmd.size;
+    x1 = cmd.vx[0] + cmd.size;
+    y1 = cmd.vy[0] + cmd.size;
+    break;
+  }
+  const int left = std::max(0, static_cast<int>(std::floor(x0)) - 1);
+  const int top = std::max(0, static_cast<int>(std::floor(y0)) - 1);
+  const int right = std::min(width, static_cast<int>(std::ceil(x1)) + 2);
+  const int bottom = std::min(height, static_cast<int>(std::ceil(y1)) + 2);
+  return {left, top, right - left, bottom - top};
+}
+
+// Draws cmd with SoftRaster.  Touches nothing but target, so tiles of a frame
+// can be drawn on several threads at once.
+void rasterize(const DrawCommand& cmd,
+               RasterImage& target,
+               const RasterImage* image) {
+  const SDL_Color& color = cmd.color;
+  switch (cmd.type) {
+  case CMD_TEXTURE:
+    SoftRaster::drawQuad(target,
+                         *image,
+                         {.clip = cmd.clip,
+                          .dst = cmd.dst,
+                          .angleDeg = cmd.angleDeg,
+                          .alphaMod = cmd.alpha,
+                          .flipped = cmd.flipped,
+                          .premultiplied = cmd.premultiplied});
+    break;
+  case CMD_RECT:
+    SoftRaster::fillRect(target, cmd.dst, color);
+    break;
+  case CMD_QUAD:
+    SoftRaster::fillPolygon(target, cmd.vx, cmd.vy, 4, color);
+    break;
+  case CMD_LINE: {
+    const int w = cmd.size;
+    if (cmd.vx[0] == cmd.vx[1] && cmd.vy[0] == cmd.vy[1]) {
+      if (w <= 1) {
+        SoftRaster::drawPoint(target, cmd.vx[0], cmd.vy[0], color);
+      } else {
+        const int halfW = w / 2;
+        SoftRaster::fillRect(
+            target, {cmd.vx[0] - halfW, cmd.vy[0] - halfW, w, w}, color);
+      }
+    } else {
+      SoftRaster::drawLine(
+          target, cmd.vx[0], cmd.vy[0], cmd.vx[1], cmd.vy[1], w, color);
+    }
+    break;
+  }
+  case CMD_CIRCLE:
+    SoftRaster::drawCircle(
+        target, cmd.vx[0], cmd.vy[0], cmd.size, color, cmd.filled);
+    break;
+  }
+}
+} // namespace
+
 int SDL_RenderDrawCircle(SDL_Renderer* renderer, int x, int y, int radius) {
   int offsetX, offsetY, d;
   int status;
@@ -118,16 +402,10 @@ std::pair<int, int> Draw::measureText(std::string_view text,
   return {ww, hh};
 }
 
-SDL_Texture* Draw::getTextTexture(std::string_view text,
-                                   const RenderTextParams& params) {
-  std::stringstream keyStream;
-  keyStream << text << params.fontSize << params.fontName << params.color.r
-            << params.color.g << params.color.b;
-  const std::string key = keyStream.str();
-  if (store.hasDynamicTexture(key)) {
-    return store.getDynamicTexture(key);
-  }
-
+SDL_Texture* Draw::createTextTexture(const std::string& key,
+                                      std::string_view text,
+                                      const RenderTextParams& params) {
+  SDL2W_ZONE("Draw::createTextTexture");
   TTF_Font* font = store.getFont(params.fontName, params.fontSize);
   const std::string textStr(text);
   auto [ww, hh] = measureText(textStr, params);
@@ -162,6 +440,9 @@ SDL_Texture* Draw::getTextTexture(std::string_view text,
 
   SDL_SetTextureBlendMode(texPtr, SDL_BLENDMODE_BLEND);
   SDL_UpdateTexture(texPtr, nullptr, blitSurface->pixels, blitSurface->pitch);
+  if (rasterEnabled) {
+    SoftRaster::setImage(texPtr, blitSurface);
+  }
   SDL_FreeSurface(blitSurface);
 
   store.storeDynamicTexture(key, texPtr);
@@ -194,41 +475,212 @@ void Draw::drawTexture(SDL_Texture* tex, const RenderableParams& params) {
                                  .flipped = params.flipped});
 }
 
-void Draw::drawTexture(SDL_Texture* tex, const RenderableParamsEx& params) {
-  SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+// Computes the destination rect and angle of a textured quad after the camera.
+// Returns false when the quad can be culled.
+bool Draw::placeQuad(const RenderableParamsEx& params,
+                     SDL_Rect& pos,
+                     double& angleDeg) const {
+  const double scaledW = static_cast<double>(params.w) * params.scale.first;
+  const double scaledH = static_cast<double>(params.h) * params.scale.second;
 
-  auto [scaleLocal,
-        angleDeg,
-        x,
-        y,
-        w,
-        h,
-        clipX,
-        clipY,
-        clipW,
-        clipH,
-        centered,
-        flipped] = params;
-  SDL_SetTextureAlphaMod(tex, globalAlpha);
-
-  SDL_RendererFlip flip = flipped ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE;
-
-  const double scaledW = static_cast<double>(w) * scaleLocal.first;
-  const double scaledH = static_cast<double>(h) * scaleLocal.second;
-
-  const int halfW = static_cast<int>(scaledW) / 2;
-  const int halfH = static_cast<int>(scaledH) / 2;
-
-  const SDL_Rect pos = {
-      .x = x + (centered ? -halfW : 0),
-      .y = y + (centered ? -halfH : 0),
-      .w = static_cast<int>(scaledW),
-      .h = static_cast<int>(scaledH),
-  };
-  const SDL_Rect clip = {clipX, clipY, clipW, clipH};
+  if (!cameraActive) {
+    const int halfW = static_cast<int>(scaledW) / 2;
+    const int halfH = static_cast<int>(scaledH) / 2;
+    pos = {
+        .x = params.x + (params.centered ? -halfW : 0),
+        .y = params.y + (params.centered ? -halfH : 0),
+        .w = static_cast<int>(scaledW),
+        .h = static_cast<int>(scaledH),
+    };
+    angleDeg = params.angleDeg;
+  } else {
+    // SDL rotates around the center of the destination rect, so transform the
+    // center and rebuild the rect around it.
+    const double centerX = params.x + (params.centered ? 0. : scaledW / 2.);
+    const double centerY = params.y + (params.centered ? 0. : scaledH / 2.);
+    const auto [screenX, screenY] = worldToScreen(centerX, centerY);
+    const double zoomedW = scaledW * camera.zoom;
+    const double zoomedH = scaledH * camera.zoom;
+    pos = {
+        .x = static_cast<int>(std::lround(screenX - zoomedW / 2.)),
+        .y = static_cast<int>(std::lround(screenY - zoomedH / 2.)),
+        .w = static_cast<int>(std::lround(zoomedW)),
+        .h = static_cast<int>(std::lround(zoomedH)),
+    };
+    angleDeg = params.angleDeg + camera.angleDeg;
+  }
+
+  if (!cullingEnabled) {
+    return true;
+  }
+  return !isOutsideTarget(pos.x + pos.w / 2.,
+                          pos.y + pos.h / 2.,
+                          std::abs(pos.w) / 2.,
+                          std::abs(pos.h) / 2.,
+                          angleDeg);
+}
+
+// Tests the bounding box of a rect rotated around its center against the
+// render target.
+bool Draw::isOutsideTarget(double centerX,
+                           double centerY,
+                           double halfW,
+                           double halfH,
+                           double angleDeg) const {
+  double extentX = halfW;
+  double extentY = halfH;
+  if (angleDeg != 0.) {
+    const double rad = angleDeg * PI / 180.;
+    const double c = std::abs(std::cos(rad));
+    const double s = std::abs(std::sin(rad));
+    extentX = halfW * c + halfH * s;
+    extentY = halfW * s + halfH * c;
+  }
+  return centerX + extentX < 0. || centerY + extentY < 0. ||
+         centerX - extentX > targetWidth || centerY - extentY > targetHeight;
+}
+
+bool Draw::isRectVisible(double x, double y, double w, double h) const {
+  const auto [centerX, centerY] = worldToScreen(x + w / 2., y + h / 2.);
+  return !isOutsideTarget(centerX,
+                          centerY,
+                          std::abs(w) / 2. * camera.zoom,
+                          std::abs(h) / 2. * camera.zoom,
+                          camera.angleDeg);
+}
+
+void Draw::pushRenderTarget(SDL_Texture* tex,
+                            int width,
+                            int height,
+                            bool clear) {
+  if (frameRaster && rasterTiles != nullptr && targetStack.empty()) {
+    // draws of tex recorded so far have to see its current pixels
+    flushRasterTiles();
+  }
+  targetStack.push_back({.tex = SDL_GetRenderTarget(sdlRenderer),
+                         .width = targetWidth,
+                         .height = targetHeight,
+                         .camera = camera,
+                         .globalAlpha = globalAlpha});
+  SDL_SetRenderTarget(sdlRenderer, tex);
+  if (dirtyRects != nullptr) {
+    dirtyRects->modifiedTextures.insert(tex);
+  }
+  targetWidth = width;
+  targetHeight = height;
+  setCamera(Camera());
+  globalAlpha = 255;
+  if (frameRaster) {
+    if (clear) {
+      int texW = 0;
+      int texH = 0;
+      SDL_QueryTexture(tex, nullptr, nullptr, &texW, &texH);
+      rasterTarget = &SoftRaster::createImage(tex, texW, texH);
+    } else {
+      rasterTarget = getRasterImage(tex);
+    }
+  }
+  if (clear) {
+    SDL_SetRenderDrawColor(sdlRenderer, 0, 0, 0, 0);
+    SDL_RenderClear(sdlRenderer);
+    SDL_SetRenderDrawColor(sdlRenderer,
+                           backgroundColor.r,
+                           backgroundColor.g,
+                           backgroundColor.b,
+                           backgroundColor.a);
+  }
+}
+
+void Draw::popRenderTarget() {
+  if (targetStack.empty()) {
+    LOG(WARN) << "[sdl2w] popRenderTarget called without a pushed target"
+              << Logger::endl;
+    return;
+  }
+  const RenderTargetState& prev = targetStack.back();
+  if (prev.tex != nullptr && prev.tex == intermediate) {
+    setIntermediateTarget();
+  } else {
+    SDL_SetRenderTarget(sdlRenderer, prev.tex);
+  }
+  if (frameRaster) {
+    RasterImage* image = nullptr;
+    if (prev.tex != nullptr && prev.tex != intermediate) {
+      image = SoftRaster::getImage(prev.tex);
+    }
+    rasterTarget = image != nullptr ? image : rasterFrame.get();
+  }
+  targetWidth = prev.width;
+  targetHeight = prev.height;
+  setCamera(prev.camera);
+  globalAlpha = prev.globalAlpha;
+  targetStack.pop_back();
+}
+
+void Draw::setCamera(const Camera& cameraA) {
+  camera = cameraA;
+  if (camera.zoom <= 0.) {
+    LOG(WARN) << "[sdl2w] Camera zoom must be positive, got " << camera.zoom
+              << Logger::endl;
+    camera.zoom = 1.;
+  }
+  cameraActive = camera.x != 0. || camera.y != 0. || camera.zoom != 1. ||
+                 camera.angleDeg != 0.;
+  const double rad = camera.angleDeg * PI / 180.;
+  cameraCos = std::cos(rad) * camera.zoom;
+  cameraSin = std::sin(rad) * camera.zoom;
+}
+
+std::pair<double, double> Draw::worldToScreen(double x, double y) const {
+  if (!cameraActive) {
+    return {x, y};
+  }
+  const double halfW = renderWidth / 2.;
+  const double halfH = renderHeight / 2.;
+  const double dx = x - (camera.x + halfW / camera.zoom);
+  const double dy = y - (camera.y + halfH / camera.zoom);
+  return {halfW + dx * cameraCos - dy * cameraSin,
+          halfH + dx * cameraSin + dy * cameraCos};
+}
+
+std::pair<double, double> Draw::screenToWorld(double x, double y) const {
+  if (!cameraActive) {
+    return {x, y};
+  }
+  const double halfW = renderWidth / 2.;
+  const double halfH = renderHeight / 2.;
+  const double dx = x - halfW;
+  const double dy = y - halfH;
+  const double zoomSq = camera.zoom * camera.zoom;
+  return {camera.x + halfW / camera.zoom +
+              (dx * cameraCos + dy * cameraSin) / zoomSq,
+          camera.y + halfH / camera.zoom +
+              (dy * cameraCos - dx * cameraSin) / zoomSq};
+}
+
+void Draw::drawTexture(SDL_Texture* tex, const RenderableParamsEx& params) {
+  SDL_Rect pos;
+  double angleDeg;
+  if (!placeQuad(params, pos, angleDeg)) {
+    counters.culledDraws++;
+    return;
+  }
 
-  SDL_SetRenderDrawBlendMode(sdlRenderer, SDL_BLENDMODE_BLEND);
-  SDL_RenderCopyEx(sdlRenderer, tex, &clip, &pos, angleDeg, nullptr, flip);
+  DrawCommand cmd;
+  cmd.type = CMD_TEXTURE;
+  cmd.tex = tex;
+  cmd.clip = {params.clipX, params.clipY, params.clipW, params.clipH};
+  cmd.dst = pos;
+  cmd.angleDeg = angleDeg;
+  cmd.alpha = static_cast<Uint8>(globalAlpha);
+  cmd.flipped = params.flipped;
+  cmd.premultiplied = params.premultipliedAlpha;
+  submit(cmd);
+  counters.drawCalls++;
+  if (tex != lastTexture) {
+    counters.textureSwitches++;
+    lastTexture = tex;
+  }
 }
 
 void Draw::setSdlRenderer(SDL_Renderer* r,
@@ -240,18 +692,129 @@ void Draw::setSdlRenderer(SDL_Renderer* r,
   sdlRenderer = r;
   renderWidth = renderWidthA;
   renderHeight = renderHeightA;
+  targetWidth = renderWidth;
+  targetHeight = renderHeight;
+
+  intermediateFormat = format;
+  createIntermediate(1.);
 
-  intermediate = SDL_CreateTexture(sdlRenderer,
-                                     format,
-                                     SDL_TEXTUREACCESS_TARGET,
-                                     renderWidth,
-                                     renderHeight);
-  SDL_SetTextureBlendMode(intermediate, SDL_BLENDMODE_BLEND);
+  setIntermediateTarget();
+}
 
+void Draw::releaseSdlRenderer() {
+  if (intermediate != nullptr) {
+    SDL_DestroyTexture(intermediate);
+    intermediate = nullptr;
+  }
+  lastTexture = nullptr;
+  sdlRenderer = nullptr;
+}
+
+bool Draw::createIntermediate(double scale) {
+  const int w = std::max(1, static_cast<int>(std::lround(renderWidth * scale)));
+  const int h =
+      std::max(1, static_cast<int>(std::lround(renderHeight * scale)));
+  SDL_Texture* tex = SDL_CreateTexture(
+      sdlRenderer, intermediateFormat, SDL_TEXTUREACCESS_TARGET, w, h);
+  if (tex == nullptr) {
+    LOG(WARN) << "[sdl2w] Could not create a " << w << "x" << h
+              << " intermediate texture: " << SDL_GetError() << Logger::endl;
+    return false;
+  }
+  SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+  if (scale < 1. && adaptiveParams.linearFilter) {
+    SDL_SetTextureScaleMode(tex, SDL_ScaleModeLinear);
+  }
+  if (intermediate != nullptr) {
+    SDL_DestroyTexture(intermediate);
+  }
+  intermediate = tex;
+  intermediateWidth = w;
+  intermediateHeight = h;
+  renderScale = scale;
+  // dirty-rect mode can't reuse anything from the old texture
+  invalidate();
+  return true;
+}
+
+void Draw::setIntermediateTarget() {
   SDL_SetRenderTarget(sdlRenderer, intermediate);
+  // SDL resets the scale whenever the target changes; draws stay in render
+  // coordinates however large the intermediate is
+  if (intermediateWidth != renderWidth || intermediateHeight != renderHeight) {
+    SDL_RenderSetScale(
+        sdlRenderer,
+        static_cast<float>(intermediateWidth) / static_cast<float>(renderWidth),
+        static_cast<float>(intermediateHeight) /
+            static_cast<float>(renderHeight));
+  }
+}
+
+void Draw::setAdaptiveResolution(bool enabled,
+                                 const AdaptiveResolutionParams& params) {
+  if (params.minScale <= 0. || params.minScale > params.maxScale ||
+      params.maxScale > 1. || params.step <= 0. || params.smoothing <= 0. ||
+      params.smoothing > 1. || params.budgetMs <= 0.) {
+    LOG_LINE(ERROR) << "[sdl2w] Invalid adaptive resolution params: scale ["
+                    << params.minScale << ", " << params.maxScale
+                    << "] step=" << params.step
+                    << " smoothing=" << params.smoothing
+                    << " budgetMs=" << params.budgetMs << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  adaptiveEnabled = enabled;
+  adaptiveParams = params;
+  smoothedFrameMs = 0.;
+  adaptiveCooldown = 0;
+  pendingRenderScale =
+      enabled ? std::clamp(pendingRenderScale, params.minScale, params.maxScale)
+              : 1.;
+}
+
+void Draw::reportFrameTime(double ms) {
+  if (!adaptiveEnabled || dirtyRects != nullptr || rasterEnabled) {
+    return;
+  }
+  const AdaptiveResolutionParams& p = adaptiveParams;
+  if (smoothedFrameMs == 0.) {
+    smoothedFrameMs = ms;
+  } else {
+    smoothedFrameMs += (ms - smoothedFrameMs) * p.smoothing;
+  }
+  if (adaptiveCooldown > 0) {
+    adaptiveCooldown--;
+    return;
+  }
+  double next = pendingRenderScale;
+  if (smoothedFrameMs > p.budgetMs) {
+    next = std::max(p.minScale, pendingRenderScale - p.step);
+  } else if (smoothedFrameMs < p.budgetMs * p.headroom) {
+    next = std::min(p.maxScale, pendingRenderScale + p.step);
+  }
+  if (next != pendingRenderScale) {
+    LOG(DEBUG) << "[sdl2w] Render scale " << pendingRenderScale << " -> "
+               << next << " (" << smoothedFrameMs << "ms)" << Logger::endl;
+    pendingRenderScale = next;
+    adaptiveCooldown = p.cooldownFrames;
+    // measured at the old scale
+    smoothedFrameMs = 0.;
+  }
+}
+
+void Draw::setRenderScale(double scale) {
+  if (scale <= 0. || scale > 1.) {
+    LOG(WARN) << "[sdl2w] Render scale must be in (0, 1], got " << scale
+              << Logger::endl;
+    scale = std::clamp(scale, 0.1, 1.);
+  }
+  pendingRenderScale = scale;
 }
 
 void Draw::setBackgroundColor(const SDL_Color& color) {
+  if (color.r != backgroundColor.r || color.g != backgroundColor.g ||
+      color.b != backgroundColor.b || color.a != backgroundColor.a) {
+    invalidate();
+  }
   backgroundColor = color;
   SDL_SetRenderDrawColor(sdlRenderer,
                          backgroundColor.r,
@@ -261,7 +824,11 @@ void Draw::setBackgroundColor(const SDL_Color& color) {
 }
 
 SDL_Texture* Draw::createTexture(SDL_Surface* surf) {
-  return SDL_CreateTextureFromSurface(sdlRenderer, surf);
+  SDL_Texture* tex = SDL_CreateTextureFromSurface(sdlRenderer, surf);
+  if (tex != nullptr && rasterEnabled) {
+    SoftRaster::setImage(tex, surf);
+  }
+  return tex;
 }
 
 void Draw::drawSprite(const Sprite& sprite, const RenderableParams& params) {
@@ -356,79 +923,261 @@ void Draw::drawAnimation(const Animation& anim,
   }
 }
 
+void Draw::drawAnimation(const AnimationSystem& anims,
+                         int id,
+                         const RenderableParams& params) {
+  const Sprite& sprite = anims.getCurrentSprite(id);
+  drawSpriteInner(sprite,
+                  {.scale = params.scale,
+                   .angleDeg = 0,
+                   .x = params.x,
+                   .y = params.y,
+                   .w = sprite.w,
+                   .h = sprite.h,
+                   .clipX = sprite.x,
+                   .clipY = sprite.y,
+                   .clipW = sprite.w,
+                   .clipH = sprite.h,
+                   .centered = params.centered,
+                   .flipped = params.flipped || anims.isFlipped(id)});
+}
+
+void Draw::drawAnimation(const AnimationSystem& anims,
+                         int id,
+                         const RenderableParamsEx& params) {
+  const Sprite& sprite = anims.getCurrentSprite(id);
+  drawSpriteInner(sprite,
+                  {.scale = params.scale,
+                   .angleDeg = params.angleDeg,
+                   .x = params.x,
+                   .y = params.y,
+                   .w = sprite.w,
+                   .h = sprite.h,
+                   .clipX = sprite.x,
+                   .clipY = sprite.y,
+                   .clipW = sprite.w,
+                   .clipH = sprite.h,
+                   .centered = params.centered,
+                   .flipped = params.flipped || anims.isFlipped(id)});
+}
+
 void Draw::drawText(std::string_view text, const RenderTextParams& params) {
-  SDL_Texture* tex = getTextTexture(text, params);
+  const std::string key = getTextKey(text, params);
+  SDL_Texture* tex =
+      store.hasDynamicTexture(key) ? store.getDynamicTexture(key) : nullptr;
   int width, height;
-  SDL_QueryTexture(tex, nullptr, nullptr, &width, &height);
-  drawTexture(tex,
-              RenderableParamsEx{.scale = params.scale,
-                                 .angleDeg = params.angleDeg,
-                                 .x = params.x,
-                                 .y = params.y,
-                                 .w = width,
-                                 .h = height,
-                                 .clipX = 0,
-                                 .clipY = 0,
-                                 .clipW = width,
-                                 .clipH = height,
-                                 .centered = params.centered,
-                                 .flipped = false});
+  if (tex != nullptr) {
+    SDL_QueryTexture(tex, nullptr, nullptr, &width, &height);
+  } else {
+    std::tie(width, height) = measureText(text, params);
+  }
+  const RenderableParamsEx quad{.scale = params.scale,
+                                .angleDeg = params.angleDeg,
+                                .x = params.x,
+                                .y = params.y,
+                                .w = width,
+                                .h = height,
+                                .clipX = 0,
+                                .clipY = 0,
+                                .clipW = width,
+                                .clipH = height,
+                                .centered = params.centered,
+                                .flipped = false};
+
+  if (tex != nullptr) {
+    counters.textCacheHits++;
+  } else {
+    // don't rasterize text that would be culled anyway
+    SDL_Rect pos;
+    double angleDeg;
+    if (!placeQuad(quad, pos, angleDeg)) {
+      counters.culledDraws++;
+      return;
+    }
+    counters.textCacheMisses++;
+    tex = createTextTexture(key, text, params);
+  }
+  drawTexture(tex, quad);
 }
 
 void Draw::drawRect(int x, int y, int w, int h, const SDL_Color& color) {
-  SDL_SetRenderDrawColor(sdlRenderer, color.r, color.g, color.b, color.a);
-  SDL_Rect rect = {x, y, w, h};
-  SDL_RenderFillRect(sdlRenderer, &rect);
-  SDL_SetRenderDrawColor(sdlRenderer,
-                         backgroundColor.r,
-                         backgroundColor.g,
-                         backgroundColor.b,
-                         backgroundColor.a);
+  const auto [centerX, centerY] = worldToScreen(x + w / 2., y + h / 2.);
+  const double halfW = std::abs(w) / 2. * camera.zoom;
+  const double halfH = std::abs(h) / 2. * camera.zoom;
+  if (cullingEnabled &&
+      isOutsideTarget(centerX, centerY, halfW, halfH, camera.angleDeg)) {
+    counters.culledDraws++;
+    return;
+  }
+  counters.primitiveCalls++;
+
+  DrawCommand cmd;
+  cmd.color = color;
+  if (camera.angleDeg == 0.) {
+    cmd.type = CMD_RECT;
+    cmd.dst = {x, y, w, h};
+    if (cameraActive) {
+      cmd.dst = {static_cast<int>(std::lround(centerX - halfW)),
+                 static_cast<int>(std::lround(centerY - halfH)),
+                 static_cast<int>(std::lround(halfW * 2.)),
+                 static_cast<int>(std::lround(halfH * 2.))};
+    }
+  } else {
+    // a rotated camera turns the rect into a quad
+    cmd.type = CMD_QUAD;
+    const double cornersX[4] = {-halfW, halfW, halfW, -halfW};
+    const double cornersY[4] = {-halfH, -halfH, halfH, halfH};
+    const double c = cameraCos / camera.zoom;
+    const double s = cameraSin / camera.zoom;
+    for (int i = 0; i < 4; i++) {
+      cmd.vx[i] = static_cast<Sint16>(
+          std::lround(centerX + cornersX[i] * c - cornersY[i] * s));
+      cmd.vy[i] = static_cast<Sint16>(
+          std::lround(centerY + cornersX[i] * s + cornersY[i] * c));
+    }
+  }
+  submit(cmd);
 }
 
 void Draw::drawLine(const std::pair<int, int>& from,
                     const std::pair<int, int>& to,
                     int lineWidth,
                     const SDL_Color& color) {
-  const int w = std::max(1, lineWidth);
+  const auto [fromX, fromY] = worldToScreen(from.first, from.second);
+  const auto [toX, toY] = worldToScreen(to.first, to.second);
+  const int w = std::max(
+      1, static_cast<int>(std::lround(std::max(1, lineWidth) * camera.zoom)));
+  if (cullingEnabled && isOutsideTarget((fromX + toX) / 2.,
+                                        (fromY + toY) / 2.,
+                                        std::abs(toX - fromX) / 2. + w / 2.,
+                                        std::abs(toY - fromY) / 2. + w / 2.,
+                                        0.)) {
+    counters.culledDraws++;
+    return;
+  }
+  counters.primitiveCalls++;
 
-  if (from.first == to.first && from.second == to.second) {
-    const Sint16 x = static_cast<Sint16>(from.first);
-    const Sint16 y = static_cast<Sint16>(from.second);
-    if (w <= 1) {
-      pixelRGBA(sdlRenderer, x, y, color.r, color.g, color.b, color.a);
-    } else {
-      const int halfW = w / 2;
-      boxRGBA(sdlRenderer,
-              x - halfW,
-              y - halfW,
-              x - halfW + w - 1,
-              y - halfW + w - 1,
-              color.r,
-              color.g,
-              color.b,
-              color.a);
-    }
-    SDL_SetRenderDrawColor(sdlRenderer,
-                           backgroundColor.r,
-                           backgroundColor.g,
-                           backgroundColor.b,
-                           backgroundColor.a);
+  DrawCommand cmd;
+  cmd.type = CMD_LINE;
+  cmd.color = color;
+  cmd.size = w;
+  cmd.vx[0] = static_cast<Sint16>(std::lround(fromX));
+  cmd.vy[0] = static_cast<Sint16>(std::lround(fromY));
+  cmd.vx[1] = static_cast<Sint16>(std::lround(toX));
+  cmd.vy[1] = static_cast<Sint16>(std::lround(toY));
+  submit(cmd);
+}
+
+void Draw::drawCircle(
+    int x, int y, int radius, const SDL_Color& color, bool filled) {
+  const auto [centerX, centerY] = worldToScreen(x, y);
+  const double zoomedRadius = radius * camera.zoom;
+  if (cullingEnabled &&
+      isOutsideTarget(centerX, centerY, zoomedRadius, zoomedRadius, 0.)) {
+    counters.culledDraws++;
     return;
   }
+  counters.primitiveCalls++;
+
+  DrawCommand cmd;
+  cmd.type = CMD_CIRCLE;
+  cmd.color = color;
+  cmd.filled = filled;
+  cmd.size = static_cast<int>(std::lround(zoomedRadius));
+  cmd.vx[0] = static_cast<Sint16>(std::lround(centerX));
+  cmd.vy[0] = static_cast<Sint16>(std::lround(centerY));
+  submit(cmd);
+}
 
-  const Uint8 gfxW = static_cast<Uint8>(std::min(w, 255));
+void Draw::execute(const DrawCommand& cmd) {
+  if (frameRaster) {
+    executeRaster(cmd);
+    return;
+  }
+  const SDL_Color& color = cmd.color;
+  switch (cmd.type) {
+  case CMD_TEXTURE: {
+    SDL_Texture* tex = cmd.tex;
+    if (cmd.premultiplied) {
+      static const SDL_BlendMode premultipliedBlend =
+          SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE,
+                                     SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                     SDL_BLENDOPERATION_ADD,
+                                     SDL_BLENDFACTOR_ONE,
+                                     SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA,
+                                     SDL_BLENDOPERATION_ADD);
+      // the software renderer has no custom blend modes; plain blending only
+      // darkens partly transparent edges there
+      if (SDL_SetTextureBlendMode(tex, premultipliedBlend) == 0) {
+        SDL_SetTextureColorMod(tex, cmd.alpha, cmd.alpha, cmd.alpha);
+      } else {
+        SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+        SDL_SetTextureColorMod(tex, 255, 255, 255);
+      }
+    } else {
+      // the same texture may have been composited premultiplied before
+      SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+      SDL_SetTextureColorMod(tex, 255, 255, 255);
+    }
+    SDL_SetTextureAlphaMod(tex, cmd.alpha);
 
-  thickLineRGBA(sdlRenderer,
-                static_cast<Sint16>(from.first),
-                static_cast<Sint16>(from.second),
-                static_cast<Sint16>(to.first),
-                static_cast<Sint16>(to.second),
-                gfxW,
+    SDL_RendererFlip flip = cmd.flipped ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE;
+    SDL_SetRenderDrawBlendMode(sdlRenderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderCopyEx(
+        sdlRenderer, tex, &cmd.clip, &cmd.dst, cmd.angleDeg, nullptr, flip);
+    return;
+  }
+  case CMD_RECT:
+    SDL_SetRenderDrawColor(sdlRenderer, color.r, color.g, color.b, color.a);
+    SDL_RenderFillRect(sdlRenderer, &cmd.dst);
+    break;
+  case CMD_QUAD:
+    filledPolygonRGBA(
+        sdlRenderer, cmd.vx, cmd.vy, 4, color.r, color.g, color.b, color.a);
+    break;
+  case CMD_LINE: {
+    const Sint16 x1 = cmd.vx[0];
+    const Sint16 y1 = cmd.vy[0];
+    const int w = cmd.size;
+    if (x1 == cmd.vx[1] && y1 == cmd.vy[1]) {
+      if (w <= 1) {
+        pixelRGBA(sdlRenderer, x1, y1, color.r, color.g, color.b, color.a);
+      } else {
+        const int halfW = w / 2;
+        boxRGBA(sdlRenderer,
+                x1 - halfW,
+                y1 - halfW,
+                x1 - halfW + w - 1,
+                y1 - halfW + w - 1,
                 color.r,
                 color.g,
                 color.b,
                 color.a);
+      }
+    } else {
+      const Uint8 gfxW = static_cast<Uint8>(std::min(w, 255));
+      thickLineRGBA(sdlRenderer,
+                    x1,
+                    y1,
+                    cmd.vx[1],
+                    cmd.vy[1],
+                    gfxW,
+                    color.r,
+                    color.g,
+                    color.b,
+                    color.a);
+    }
+    break;
+  }
+  case CMD_CIRCLE:
+    SDL_SetRenderDrawColor(sdlRenderer, color.r, color.g, color.b, color.a);
+    if (cmd.filled) {
+      SDL_RenderFillCircle(sdlRenderer, cmd.vx[0], cmd.vy[0], cmd.size);
+    } else {
+      SDL_RenderDrawCircle(sdlRenderer, cmd.vx[0], cmd.vy[0], cmd.size);
+    }
+    break;
+  }
   SDL_SetRenderDrawColor(sdlRenderer,
                          backgroundColor.r,
                          backgroundColor.g,
@@ -436,23 +1185,458 @@ void Draw::drawLine(const std::pair<int, int>& from,
                          backgroundColor.a);
 }
 
-void Draw::drawCircle(
-    int x, int y, int radius, const SDL_Color& color, bool filled) {
-  SDL_SetRenderDrawColor(sdlRenderer, color.r, color.g, color.b, color.a);
-  if (filled) {
-    SDL_RenderFillCircle(sdlRenderer, x, y, radius);
+void Draw::executeRaster(const DrawCommand& cmd) {
+  rasterUploaded = false;
+  const RasterImage* image =
+      cmd.type == CMD_TEXTURE ? getRasterImage(cmd.tex) : nullptr;
+  if (rasterTiles != nullptr && targetStack.empty()) {
+    RasterTileState::Recorded& recorded =
+        rasterTiles->commands.emplace_back(cmd, image);
+    recorded.cmd.bounds = getCommandBounds(cmd, renderWidth, renderHeight);
+    return;
+  }
+  rasterize(cmd, *rasterTarget, image);
+}
+
+// The raster copy of tex, read back from the renderer when Draw didn't
+// create tex itself (or created it before the backend was on).
+RasterImage* Draw::getRasterImage(SDL_Texture* tex) {
+  RasterImage* image = SoftRaster::getImage(tex);
+  if (image != nullptr) {
+    return image;
+  }
+  SDL2W_ZONE("Draw::getRasterImage");
+  counters.rasterReadbacks++;
+  int w = 0;
+  int h = 0;
+  SDL_QueryTexture(tex, nullptr, nullptr, &w, &h);
+  image = &SoftRaster::createImage(tex, w, h);
+
+  SDL_Texture* prevTarget = SDL_GetRenderTarget(sdlRenderer);
+  SDL_Texture* copy = SDL_CreateTexture(
+      sdlRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+  bool ok = false;
+  if (copy != nullptr) {
+    SDL_BlendMode blendMode = SDL_BLENDMODE_BLEND;
+    Uint8 alphaMod = 255;
+    Uint8 r = 255;
+    Uint8 g = 255;
+    Uint8 b = 255;
+    SDL_GetTextureBlendMode(tex, &blendMode);
+    SDL_GetTextureAlphaMod(tex, &alphaMod);
+    SDL_GetTextureColorMod(tex, &r, &g, &b);
+    SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_NONE);
+    SDL_SetTextureAlphaMod(tex, 255);
+    SDL_SetTextureColorMod(tex, 255, 255, 255);
+    SDL_SetRenderTarget(sdlRenderer, copy);
+    ok = SDL_RenderCopy(sdlRenderer, tex, nullptr, nullptr) == 0 &&
+         SDL_RenderReadPixels(sdlRenderer,
+                              nullptr,
+                              SDL_PIXELFORMAT_ARGB8888,
+                              image->pixels.data(),
+                              w * static_cast<int>(sizeof(uint32_t))) == 0;
+    SDL_SetTextureBlendMode(tex, blendMode);
+    SDL_SetTextureAlphaMod(tex, alphaMod);
+    SDL_SetTextureColorMod(tex, r, g, b);
+    SDL_DestroyTexture(copy);
+  }
+  if (prevTarget != nullptr && prevTarget == intermediate) {
+    setIntermediateTarget();
   } else {
-    SDL_RenderDrawCircle(sdlRenderer, x, y, radius);
+    SDL_SetRenderTarget(sdlRenderer, prevTarget);
   }
-  SDL_SetRenderDrawColor(sdlRenderer,
-                         backgroundColor.r,
-                         backgroundColor.g,
-                         backgroundColor.b,
-                         backgroundColor.a);
+  if (!ok) {
+    // an empty image, so the texture is skipped instead of retried every draw
+    LOG(WARN) << "[sdl2w] Raster backend could not read back a " << w << "x"
+              << h << " texture, it won't be drawn: " << SDL_GetError()
+              << Logger::endl;
+    image = &SoftRaster::createImage(tex, 0, 0);
+  }
+  return image;
+}
+
+void Draw::uploadRasterFrame() {
+  if (!frameRaster || rasterUploaded) {
+    return;
+  }
+  SDL2W_ZONE("Draw::uploadRasterFrame");
+  rasterUploaded = true;
+  if (rasterTiles != nullptr) {
+    flushRasterTiles();
+  }
+  SDL_UpdateTexture(intermediate,
+                    nullptr,
+                    rasterFrame->pixels.data(),
+                    rasterFrame->w * static_cast<int>(sizeof(uint32_t)));
+}
+
+// Bins the recorded draws into tiles and draws the tiles on the pool's
+// threads.  Tiles are handed out by estimated cost, biggest first to the
+// least loaded thread, so a crowded part of the screen doesn't leave the
+// other threads waiting.
+void Draw::flushRasterTiles() {
+  RasterTileState& state = *rasterTiles;
+  if (!state.clearPending && state.commands.empty()) {
+    return;
+  }
+  SDL2W_ZONE("Draw::flushRasterTiles");
+  const int tileSize = RASTER_TILE_SIZE;
+  const int tilesX = (renderWidth + tileSize - 1) / tileSize;
+  const int tilesY = (renderHeight + tileSize - 1) / tileSize;
+  const int numTiles = tilesX * tilesY;
+  if (numTiles <= 0) {
+    state.commands.clear();
+    return;
+  }
+  state.bins.resize(numTiles);
+  for (std::vector<int>& bin : state.bins) {
+    bin.clear();
+  }
+  state.costs.assign(
+      numTiles, state.clearPending ? int64_t{tileSize} * tileSize : 0);
+  for (int i = 0; i < static_cast<int>(state.commands.size()); i++) {
+    const SDL_Rect& b = state.commands[i].cmd.bounds;
+    if (b.w <= 0 || b.h <= 0) {
+      continue;
+    }
+    for (int ty = b.y / tileSize; ty <= (b.y + b.h - 1) / tileSize; ty++) {
+      const int h = std::min(b.y + b.h, (ty + 1) * tileSize) -
+                    std::max(b.y, ty * tileSize);
+      for (int tx = b.x / tileSize; tx <= (b.x + b.w - 1) / tileSize; tx++) {
+        const int w = std::min(b.x + b.w, (tx + 1) * tileSize) -
+                      std::max(b.x, tx * tileSize);
+        const int tile = ty * tilesX + tx;
+        state.bins[tile].push_back(i);
+        state.costs[tile] += int64_t{w} * h + RASTER_DRAW_COST;
+      }
+    }
+  }
+
+  const int numJobs = std::min(state.pool->getNumThreads(), numTiles);
+  state.order.resize(numTiles);
+  std::iota(state.order.begin(), state.order.end(), 0);
+  std::stable_sort(state.order.begin(), state.order.end(), [&](int a, int b) {
+    return state.costs[a] > state.costs[b];
+  });
+  state.jobs.resize(numJobs);
+  for (std::vector<int>& job : state.jobs) {
+    job.clear();
+  }
+  state.jobCosts.assign(numJobs, 0);
+  for (int tile : state.order) {
+    if (state.costs[tile] == 0) {
+      break;
+    }
+    const auto lightest =
+        std::min_element(state.jobCosts.begin(), state.jobCosts.end());
+    state.jobs[lightest - state.jobCosts.begin()].push_back(tile);
+    *lightest += state.costs[tile];
+  }
+
+  RasterImage& frame = *rasterFrame;
+  const SDL_Color background = backgroundColor;
+  const bool clear = state.clearPending;
+  state.pool->parallelFor(numJobs, 1, [&](int begin, int end) {
+    for (int j = begin; j < end; j++) {
+      for (int tile : state.jobs[j]) {
+        const SDL_Rect tileRect = {(tile % tilesX) * tileSize,
+                                   (tile / tilesX) * tileSize,
+                                   tileSize,
+                                   tileSize};
+        SoftRaster::setClipRect(&tileRect);
+        if (clear) {
+          SoftRaster::clear(frame, background);
+        }
+        for (int i : state.bins[tile]) {
+          const RasterTileState::Recorded& recorded = state.commands[i];
+          rasterize(recorded.cmd, frame, recorded.image);
+        }
+      }
+    }
+    SoftRaster::setClipRect(nullptr);
+  });
+  state.clearPending = false;
+  state.commands.clear();
+  SoftRaster::freeReleased();
+}
+
+// Starts or stops drawing in tiles to match setRasterThreads(), between
+// frames.
+void Draw::applyRasterThreads() {
+  int numThreads =
+      rasterThreads > 0 ? rasterThreads : WorkerPool::getHardwareThreads();
+#ifdef __EMSCRIPTEN__
+  // no threads to draw tiles on
+  numThreads = 1;
+#endif
+  if (numThreads <= 1) {
+    rasterTiles.reset();
+    return;
+  }
+  if (rasterTiles == nullptr) {
+    rasterTiles = std::make_unique<RasterTileState>();
+  }
+  if (rasterTiles->numThreads != numThreads) {
+    rasterTiles->pool = std::make_unique<WorkerPool>(numThreads);
+    rasterTiles->numThreads = numThreads;
+  }
+}
+
+int Draw::getRasterThreads() const {
+  return rasterTiles != nullptr ? rasterTiles->pool->getNumThreads() : 1;
+}
+
+void Draw::setRasterBackend(bool enabled) {
+  if (enabled == rasterEnabled) {
+    return;
+  }
+  if (!enabled) {
+    // whatever was rasterized so far in this frame still has to reach it
+    uploadRasterFrame();
+    rasterEnabled = false;
+    frameRaster = false;
+    rasterTarget = nullptr;
+    rasterFrame.reset();
+    rasterTiles.reset();
+    SoftRaster::releaseAll();
+    return;
+  }
+  if (dirtyRects != nullptr) {
+    LOG(WARN) << "[sdl2w] The raster backend is not available in dirty-rect "
+                 "mode"
+              << Logger::endl;
+    return;
+  }
+  // the frame is uploaded as is, so the intermediate must be laid out the
+  // same way
+  if (intermediateFormat != SDL_PIXELFORMAT_ARGB8888 &&
+      intermediateFormat != SDL_PIXELFORMAT_RGB888) {
+    LOG(WARN) << "[sdl2w] The raster backend needs a 32-bit RGB "
+                 "intermediate, not "
+              << SDL_GetPixelFormatName(intermediateFormat) << Logger::endl;
+    return;
+  }
+  rasterEnabled = true;
+  rasterFrame = std::make_unique<RasterImage>();
+  rasterFrame->w = renderWidth;
+  rasterFrame->h = renderHeight;
+  rasterFrame->pixels.assign(
+      static_cast<size_t>(renderWidth) * renderHeight, 0);
+  LOG(INFO) << "[sdl2w] Raster backend on, using "
+            << SoftRaster::getIsaName(SoftRaster::getIsa()) << " kernels"
+            << Logger::endl;
+}
+
+void Draw::refreshRasterImage(SDL_Texture* tex) {
+  // read back again on the next draw
+  SoftRaster::releaseImage(tex);
+}
+
+void Draw::submit(const DrawCommand& cmd) {
+  if (dirtyRects == nullptr || !targetStack.empty()) {
+    execute(cmd);
+    return;
+  }
+
+  DrawCommand& recorded = dirtyRects->commands.emplace_back(cmd);
+  recorded.bounds = getCommandBounds(cmd, renderWidth, renderHeight);
+}
+
+void Draw::setDirtyRectMode(bool enabled, double fullRedrawThreshold) {
+  if (enabled && rasterEnabled) {
+    LOG(WARN) << "[sdl2w] Dirty-rect mode is not available with the raster "
+                 "backend"
+              << Logger::endl;
+    return;
+  }
+  if (!enabled) {
+    if (dirtyRects != nullptr) {
+      // draws recorded so far in this frame still have to reach it
+      flushRecorded();
+      dirtyRects.reset();
+    }
+    return;
+  }
+  if (dirtyRects == nullptr) {
+    dirtyRects = std::make_unique<DirtyRectState>();
+    SDL_RendererInfo info;
+    softwareRenderer = SDL_GetRendererInfo(sdlRenderer, &info) == 0 &&
+                       (info.flags & SDL_RENDERER_SOFTWARE) != 0;
+  }
+  dirtyRects->fullRedrawThreshold = fullRedrawThreshold;
+  dirtyRects->fullRedraw = true;
+}
+
+void Draw::invalidate() {
+  if (dirtyRects != nullptr) {
+    dirtyRects->fullRedraw = true;
+    dirtyRects->compositeAll = true;
+  }
+}
+
+// Diffs this frame's commands against the last frame's, then clears and
+// replays only the damaged part of the intermediate texture.
+void Draw::flushRecorded() {
+  uploadRasterFrame();
+  if (dirtyRects == nullptr || dirtyRects->flushed) {
+    return;
+  }
+  SDL2W_ZONE("Draw::flushRecorded");
+  DirtyRectState& state = *dirtyRects;
+  const auto& cur = state.commands;
+  const auto& prev = state.prevCommands;
+  state.flushed = true;
+  state.hasDamage = false;
+  state.damage.clear();
+
+  bool full = state.fullRedraw;
+  if (!full) {
+    // Commands are matched in order, by content rather than position.  Every
+    // command left unmatched in either frame is damaged, so the matched ones
+    // cover the undamaged pixels in the same order in both frames.
+    size_t i = 0;
+    size_t j = 0;
+    while (i < cur.size() && j < prev.size()) {
+      if (isSameCommand(cur[i], prev[j])) {
+        if (cur[i].tex != nullptr &&
+            state.modifiedTextures.count(cur[i].tex) != 0) {
+          addToDamage(state, cur[i].bounds);
+        }
+        i++;
+        j++;
+        continue;
+      }
+      // resync at the nearest command the other frame has too
+      size_t skipCur = 0;
+      size_t skipPrev = 0;
+      for (size_t k = 1; k <= DAMAGE_RESYNC_WINDOW; k++) {
+        if (i + k < cur.size() && isSameCommand(cur[i + k], prev[j])) {
+          skipCur = k;
+          break;
+        }
+        if (j + k < prev.size() && isSameCommand(cur[i], prev[j + k])) {
+          skipPrev = k;
+          break;
+        }
+      }
+      if (skipCur == 0 && skipPrev == 0) {
+        // changed in place
+        skipCur = 1;
+        skipPrev = 1;
+      }
+      for (size_t end = i + skipCur; i < end; i++) {
+        addToDamage(state, cur[i].bounds);
+      }
+      for (size_t end = j + skipPrev; j < end; j++) {
+        addToDamage(state, prev[j].bounds);
+      }
+    }
+    for (; i < cur.size(); i++) {
+      addToDamage(state, cur[i].bounds);
+    }
+    for (; j < prev.size(); j++) {
+      addToDamage(state, prev[j].bounds);
+    }
+    int64_t damagedArea = 0;
+    for (const SDL_Rect& r : state.damage) {
+      damagedArea += getArea(r);
+    }
+    const double area = static_cast<double>(renderWidth) * renderHeight;
+    full = static_cast<double>(damagedArea) > area * state.fullRedrawThreshold;
+  }
+
+  DirtyRectStats frameStats;
+  setIntermediateTarget();
+  if (full) {
+    state.damage.assign(1, {0, 0, renderWidth, renderHeight});
+    state.hasDamage = true;
+    SDL_SetRenderDrawColor(sdlRenderer,
+                           backgroundColor.r,
+                           backgroundColor.g,
+                           backgroundColor.b,
+                           backgroundColor.a);
+    SDL_RenderClear(sdlRenderer);
+    for (const DrawCommand& cmd : cur) {
+      execute(cmd);
+    }
+    frameStats.replayedCommands = static_cast<int>(cur.size());
+  } else if (state.hasDamage) {
+    // the rects are disjoint, so each is cleared and redrawn on its own
+    for (const SDL_Rect& damage : state.damage) {
+      // SDL_RenderClear ignores the clip rect, so clear with a fill
+      SDL_RenderSetClipRect(sdlRenderer, &damage);
+      SDL_SetRenderDrawBlendMode(sdlRenderer, SDL_BLENDMODE_NONE);
+      SDL_SetRenderDrawColor(sdlRenderer,
+                             backgroundColor.r,
+                             backgroundColor.g,
+                             backgroundColor.b,
+                             backgroundColor.a);
+      SDL_RenderFillRect(sdlRenderer, &damage);
+      SDL_SetRenderDrawBlendMode(sdlRenderer, SDL_BLENDMODE_BLEND);
+      for (const DrawCommand& cmd : cur) {
+        if (overlaps(cmd.bounds, damage)) {
+          execute(cmd);
+          frameStats.replayedCommands++;
+        }
+      }
+    }
+    SDL_RenderSetClipRect(sdlRenderer, nullptr);
+  }
+  state.fullRedraw = false;
+  if (full) {
+    state.compositeAll = true;
+  }
+  frameStats.fullRedraw = full;
+  frameStats.damageRects = static_cast<int>(state.damage.size());
+  for (const SDL_Rect& damage : state.damage) {
+    frameStats.damagedPixels += damage.w * damage.h;
+  }
+  frameStats.skippedPresent = !state.hasDamage;
+  dirtyRectStats = frameStats;
+}
+
+bool Draw::canDrawDirect() const {
+  return directPresent && renderRotationAngle == 0. && renderScale == 1. &&
+         dirtyRects == nullptr && !rasterEnabled;
 }
 
 void Draw::clearScreen() {
-  SDL_SetRenderTarget(sdlRenderer, intermediate);
+  // a new render scale is applied between frames
+  const double scale =
+      dirtyRects != nullptr || rasterEnabled ? 1. : pendingRenderScale;
+  if (scale != renderScale && targetStack.empty() &&
+      !createIntermediate(scale)) {
+    pendingRenderScale = renderScale;
+  }
+  frameDirect = canDrawDirect();
+  frameRaster = rasterEnabled;
+  if (frameRaster) {
+    rasterUploaded = false;
+    rasterTarget = rasterFrame.get();
+    applyRasterThreads();
+    if (rasterTiles != nullptr) {
+      // a frame that was never uploaded is dropped
+      rasterTiles->commands.clear();
+      rasterTiles->clearPending = true;
+    } else {
+      SoftRaster::clear(*rasterFrame, backgroundColor);
+    }
+    SoftRaster::freeReleased();
+    setIntermediateTarget();
+    return;
+  }
+  if (dirtyRects != nullptr) {
+    // the recorded frame is the whole frame; previous pixels are kept so only
+    // damaged areas need clearing
+    dirtyRects->commands.clear();
+    setIntermediateTarget();
+    return;
+  }
+  if (frameDirect) {
+    SDL_SetRenderTarget(sdlRenderer, nullptr);
+  } else {
+    setIntermediateTarget();
+  }
   SDL_SetRenderDrawColor(sdlRenderer,
                          backgroundColor.r,
                          backgroundColor.g,
@@ -461,7 +1645,29 @@ void Draw::clearScreen() {
   SDL_RenderClear(sdlRenderer);
 }
 
-void Draw::renderIntermediate() {
+void Draw::compositeIntermediate() {
+  uploadRasterFrame();
+  if (dirtyRects != nullptr) {
+    flushRecorded();
+    if (!dirtyRects->hasDamage) {
+      return;
+    }
+    // a software renderer's backbuffer keeps its pixels between presents, so
+    // only the damaged rects have to be copied to it
+    if (softwareRenderer && renderRotationAngle == 0. &&
+        !dirtyRects->compositeAll) {
+      SDL_SetRenderTarget(sdlRenderer, nullptr);
+      for (const SDL_Rect& damage : dirtyRects->damage) {
+        SDL_RenderCopy(sdlRenderer, intermediate, &damage, &damage);
+      }
+      return;
+    }
+    dirtyRects->compositeAll = renderRotationAngle != 0.;
+  } else if (frameDirect) {
+    // already in the backbuffer
+    SDL_SetRenderTarget(sdlRenderer, nullptr);
+    return;
+  }
   SDL_SetRenderTarget(sdlRenderer, nullptr);
   SDL_RenderClear(sdlRenderer);
   SDL_RenderCopyEx(sdlRenderer,
@@ -471,8 +1677,28 @@ void Draw::renderIntermediate() {
                    renderRotationAngle,
                    nullptr,
                    SDL_FLIP_NONE);
-  SDL_RenderPresent(sdlRenderer);
-  SDL_SetRenderTarget(sdlRenderer, intermediate);
+}
+
+void Draw::present() {
+  if (dirtyRects == nullptr || dirtyRects->hasDamage) {
+    SDL_RenderPresent(sdlRenderer);
+  }
+  lastFrameCounters = counters;
+  counters = DrawCounters();
+  lastTexture = nullptr;
+  if (dirtyRects != nullptr) {
+    DirtyRectState& state = *dirtyRects;
+    std::swap(state.commands, state.prevCommands);
+    state.commands.clear();
+    state.modifiedTextures.clear();
+    state.flushed = false;
+    state.hasDamage = false;
+  }
   clearScreen();
 }
+
+void Draw::renderIntermediate() {
+  compositeIntermediate();
+  present();
+}
 } // namespace sdl2w
@@ -7,6 +7,7 @@
 #include <string_view>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #if __has_include(<SDL2/SDL_pixels.h>) && __has_include(<SDL2/SDL_stdinc.h>)
 #include <SDL2/SDL_pixels.h>
@@ -18,9 +19,16 @@
 #error "Could not find SDL pixel/stdinc headers in either SDL2/ or root include paths"
 #endif
 
+struct SDL_Rect;
+
 namespace sdl2w {
 
 class Store;
+class AnimationSystem;
+struct DrawCommand;
+struct DirtyRectState;
+struct RasterImage;
+struct RasterTileState;
 
 struct RenderableParamsEx {
   std::pair<double, double> scale = {0., 0.};
@@ -35,6 +43,9 @@ struct RenderableParamsEx {
   int clipH = 0;
   bool centered = true;
   bool flipped = false;
+  // the texture's colors are already multiplied by its alpha, as with
+  // anything drawn into a transparent render target
+  bool premultipliedAlpha = false;
 };
 
 struct RenderableParams {
@@ -72,9 +83,76 @@ struct Sprite {
   bool flipped = false;
 };
 
+// Work submitted to the SDL renderer, counted per frame.  Plain ints so they
+// can stay on in release builds.
+struct DrawCounters {
+  // SDL_RenderCopyEx calls for sprites, animations and text
+  int drawCalls = 0;
+  // draw calls using a different texture than the one before
+  int textureSwitches = 0;
+  // rects, lines and circles
+  int primitiveCalls = 0;
+  int textCacheHits = 0;
+  int textCacheMisses = 0;
+  // draws skipped because they were entirely outside the render target,
+  // always 0 while culling is off (see setCullingEnabled)
+  int culledDraws = 0;
+  // textures the raster backend had to read back from the renderer
+  int rasterReadbacks = 0;
+};
+
+// View into the world applied to every sprite, animation, text and primitive
+// draw.  x/y is the world position shown at the top left of the render target
+// when the camera is not rotated; zoom and rotation are around the center of
+// the render target.  The default camera maps world coordinates 1:1 to render
+// coordinates.
+struct Camera {
+  double x = 0.;
+  double y = 0.;
+  double zoom = 1.;
+  double angleDeg = 0.;
+};
+
+// What dirty-rect mode did for the last presented frame.
+struct DirtyRectStats {
+  // total area of the damaged rects, which don't overlap
+  int damagedPixels = 0;
+  int damageRects = 0;
+  int replayedCommands = 0;
+  bool fullRedraw = false;
+  // nothing changed, so the frame was neither composited nor presented
+  bool skippedPresent = false;
+};
+
+// Controls adaptive resolution, which lowers the size of the intermediate
+// texture while frames are over budget and raises it again when there is
+// headroom.  The render size seen by the game never changes; the intermediate
+// is scaled up to it when composited.
+struct AdaptiveResolutionParams {
+  // update + draw time per frame to stay under, in ms; present is left out
+  // since it does not depend on the render resolution (and waits for vsync)
+  double budgetMs = 1000. / 60. * 0.8;
+  // render scale bounds, in (0, 1]
+  double minScale = 0.5;
+  double maxScale = 1.;
+  double step = 0.1;
+  // weight of the newest frame in the smoothed frame time
+  double smoothing = 0.1;
+  // the scale is raised once the smoothed time is below this fraction of
+  // the budget
+  double headroom = 0.7;
+  // frames to wait after a change before the next one
+  int cooldownFrames = 30;
+  // filter the upscale linearly instead of with the renderer's default
+  bool linearFilter = true;
+};
+
 enum DrawMode {
   CPU,
   GPU,
+  // benchmark the available renderers at startup and use the fastest, see
+  // RendererProbe
+  AUTO,
 };
 
 class Draw {
@@ -84,15 +162,92 @@ class Draw {
 
   SDL_Renderer* sdlRenderer = nullptr;
   SDL_Texture* intermediate = nullptr;
+  Uint32 intermediateFormat = 0;
+  int intermediateWidth = 0;
+  int intermediateHeight = 0;
 
   SDL_Color backgroundColor = {0, 0, 0, 255};
   double renderRotationAngle = 0.0;
+  bool directPresent = false;
+  // whether the frame in progress is drawn straight to the window, decided
+  // when it starts
+  bool frameDirect = false;
+
+  bool adaptiveEnabled = false;
+  AdaptiveResolutionParams adaptiveParams;
+  // the scale of the intermediate texture, and the one it will be
+  // reallocated at when the next frame starts
+  double renderScale = 1.;
+  double pendingRenderScale = 1.;
+  double smoothedFrameMs = 0.;
+  int adaptiveCooldown = 0;
   int globalAlpha = 255;
   std::unordered_map<std::string, bool> invalidSpriteWarnings;
+  DrawCounters counters;
+  DrawCounters lastFrameCounters;
+  SDL_Texture* lastTexture = nullptr;
+
+  Camera camera;
+  // false while the camera is the identity, so the common case skips the
+  // transform entirely
+  bool cameraActive = false;
+  double cameraCos = 1.;
+  double cameraSin = 0.;
+  bool cullingEnabled = true;
 
-  SDL_Texture* getTextTexture(std::string_view text,
-                              const RenderTextParams& params);
+  // Render targets entered with pushRenderTarget(), with the state they
+  // replaced.  Culling uses the size of the current target.
+  struct RenderTargetState {
+    SDL_Texture* tex = nullptr;
+    int width = 0;
+    int height = 0;
+    Camera camera;
+    int globalAlpha = 255;
+  };
+  std::vector<RenderTargetState> targetStack;
+  int targetWidth = 0;
+  int targetHeight = 0;
+
+  // set while dirty-rect mode is on
+  std::unique_ptr<DirtyRectState> dirtyRects;
+  DirtyRectStats dirtyRectStats;
+  bool softwareRenderer = false;
+
+  bool rasterEnabled = false;
+  // whether the frame in progress is drawn by the raster backend, decided
+  // when it starts
+  bool frameRaster = false;
+  bool rasterUploaded = false;
+  std::unique_ptr<RasterImage> rasterFrame;
+  // the image draws go to: rasterFrame or a pushed render target's
+  RasterImage* rasterTarget = nullptr;
+  // see setRasterThreads(); tiles are only set up for more than one thread
+  int rasterThreads = 0;
+  std::unique_ptr<RasterTileState> rasterTiles;
+
+  SDL_Texture* createTextTexture(const std::string& key,
+                                 std::string_view text,
+                                 const RenderTextParams& params);
   void drawSpriteInner(const Sprite& sprite, const RenderableParamsEx& params);
+  bool placeQuad(const RenderableParamsEx& params,
+                 SDL_Rect& pos,
+                 double& angleDeg) const;
+  bool isOutsideTarget(double centerX,
+                       double centerY,
+                       double halfW,
+                       double halfH,
+                       double angleDeg) const;
+  // runs a draw, or records it in dirty-rect mode
+  void submit(const DrawCommand& cmd);
+  void execute(const DrawCommand& cmd);
+  void executeRaster(const DrawCommand& cmd);
+  RasterImage* getRasterImage(SDL_Texture* tex);
+  void uploadRasterFrame();
+  void flushRasterTiles();
+  void applyRasterThreads();
+  bool canDrawDirect() const;
+  bool createIntermediate(double scale);
+  void setIntermediateTarget();
 
 public:
   void drawTexture(SDL_Texture* tex, const RenderableParams& params);
@@ -105,21 +260,116 @@ public:
                       int renderHeight,
                       Uint32 format);
   SDL_Renderer* getSdlRenderer() { return sdlRenderer; }
+  // Destroys the textures Draw owns and forgets the renderer, which can then
+  // be destroyed.
+  void releaseSdlRenderer();
+  // Holds the last frame only when it was not drawn directly.
   SDL_Texture* getIntermediate() { return intermediate; }
   std::pair<int, int> getRenderSize() const {
     return {renderWidth, renderHeight};
   }
+  // Takes effect from the next frame when direct present is in use.
   void setRenderRotationAngle(double angle) { renderRotationAngle = angle; }
+  // Direct present draws frames straight into the window's backbuffer instead
+  // of the intermediate texture, saving the full-screen copy in
+  // compositeIntermediate().  Frames that need the intermediate (a render
+  // rotation or dirty-rect mode) still go through it; the switch happens at
+  // the start of a frame.
+  void setDirectPresent(bool enabled) { directPresent = enabled; }
+  bool isDirectPresent() const { return directPresent; }
+  // the frame in progress is being drawn directly
+  bool isDrawingDirect() const { return frameDirect; }
+
+  // The raster backend draws frames with SoftRaster in system memory and
+  // uploads the finished frame into the intermediate texture, instead of
+  // going through the renderer for every draw.  It is meant for the software
+  // renderer (Window2Params::rasterBackend with DrawMode::CPU) and takes
+  // effect when the next frame starts.  Every channel is within 2 of what the
+  // software renderer draws, except on the edges of rotated and scaled quads,
+  // where the two can sample a different texel (at most 1 in 1000 pixels of
+  // a frame, which RenderBench checks), and premultiplied textures blend
+  // correctly instead of falling back to plain blending.
+  //
+  // Drawn textures need a copy of their pixels: textures from createTexture()
+  // and text get one when they are created, any other texture is read back
+  // from the renderer the first time it is drawn.  Call refreshRasterImage()
+  // after changing a texture with SDL_UpdateTexture.  Render targets entered
+  // with pushRenderTarget() are only drawn in their copy, so they must be
+  // redrawn after turning the backend off.  Dirty-rect mode and a render
+  // scale other than 1 are not supported alongside it.
+  void setRasterBackend(bool enabled);
+  bool isRasterBackend() const { return rasterEnabled; }
+  void refreshRasterImage(SDL_Texture* tex);
+  // With more than one thread the raster backend records a frame's draws and,
+  // when the frame is uploaded, splits it into 64x64 tiles that the threads
+  // draw in parallel, each tile with its draws in submission order.  Pixels
+  // are the same as with one thread, which draws everything as it is
+  // submitted.  Draws into render targets are not split.  numThreads <= 0
+  // uses one thread per hardware thread (the default); takes effect when the
+  // next frame starts.
+  void setRasterThreads(int numThreads) { rasterThreads = numThreads; }
+  // threads drawing the frame in progress
+  int getRasterThreads() const;
+
+  // See AdaptiveResolutionParams.  Has no effect in dirty-rect mode or with
+  // the raster backend, which need the intermediate at full size.
+  void setAdaptiveResolution(bool enabled,
+                             const AdaptiveResolutionParams& params = {});
+  bool isAdaptiveResolution() const { return adaptiveEnabled; }
+  // Feeds the adaptive resolution controller; Window calls it once per
+  // presented frame with the frame's update + draw time.
+  void reportFrameTime(double ms);
+  double getSmoothedFrameMs() const { return smoothedFrameMs; }
+  // Size of the intermediate relative to the render size, in (0, 1].  A new
+  // scale takes effect when the next frame starts.
+  void setRenderScale(double scale);
+  double getRenderScale() const { return renderScale; }
   void setGlobalAlpha(int alpha) { globalAlpha = alpha; }
   int getGlobalAlpha() const { return globalAlpha; }
 
+  // The camera transforms everything drawn after it is set, until it is set
+  // again or reset.
+  void setCamera(const Camera& camera);
+  const Camera& getCamera() const { return camera; }
+  void resetCamera() { setCamera(Camera()); }
+  std::pair<double, double> worldToScreen(double x, double y) const;
+  std::pair<double, double> screenToWorld(double x, double y) const;
+
+  // Draws whose transformed bounds lie entirely outside the render target are
+  // skipped before reaching SDL and counted in DrawCounters::culledDraws.
+  void setCullingEnabled(bool enabled) { cullingEnabled = enabled; }
+  bool isCullingEnabled() const { return cullingEnabled; }
+  // True when any part of the world space rect would land on the render target
+  // under the current camera.
+  bool isRectVisible(double x, double y, double w, double h) const;
+
+  // Draws into tex (created with SDL_TEXTUREACCESS_TARGET) until the matching
+  // popRenderTarget().  The camera and global alpha are reset while inside and
+  // restored on pop.  clear fills tex with transparent black first.
+  void pushRenderTarget(SDL_Texture* tex, int width, int height, bool clear);
+  void popRenderTarget();
+
   void setBackgroundColor(const SDL_Color& color);
+  const SDL_Color& getBackgroundColor() const { return backgroundColor; }
+
+  // Counters for the frame in progress.  renderIntermediate() (present())
+  // moves them to the last frame counters and starts a new frame from zero.
+  const DrawCounters& getCounters() const { return counters; }
+  const DrawCounters& getLastFrameCounters() const {
+    return lastFrameCounters;
+  }
 
   SDL_Texture* createTexture(SDL_Surface* surf);
   void drawSprite(const Sprite& sprite, const RenderableParams& params);
   void drawSprite(const Sprite& sprite, const RenderableParamsEx& params);
   void drawAnimation(const Animation& anim, const RenderableParams& params);
   void drawAnimation(const Animation& anim, const RenderableParamsEx& params);
+  void drawAnimation(const AnimationSystem& anims,
+                     int id,
+                     const RenderableParams& params);
+  void drawAnimation(const AnimationSystem& anims,
+                     int id,
+                     const RenderableParamsEx& params);
   void drawText(std::string_view text, const RenderTextParams& params);
   std::pair<int, int> measureText(std::string_view text,
                                   const RenderTextParams& params);
@@ -131,8 +381,33 @@ public:
   void drawCircle(
       int x, int y, int radius, const SDL_Color& color, bool filled = true);
 
+  // Dirty-rect mode keeps the previous frame in the intermediate texture.
+  // Draws into it are recorded and diffed against the last frame's, and only
+  // the changed areas are cleared and redrawn.  Draws are matched by content,
+  // so inserting or removing one (a tooltip, a notification) only damages
+  // its own area.  Damage is kept as up to 8 rects, merged where they
+  // overlap.  Past fullRedrawThreshold (a fraction of the render area) the
+  // whole frame is redrawn.  A frame without changes is not composited or
+  // presented at all, and software renderers only copy the damaged rects to
+  // the window.  Intended for mostly static screens such as menus and tools.
+  //
+  // Changes Draw can't see need invalidate(): textures updated with
+  // SDL_UpdateTexture, or anything drawn on the renderer directly.
+  void setDirtyRectMode(bool enabled, double fullRedrawThreshold = 0.5);
+  bool isDirtyRectMode() const { return dirtyRects != nullptr; }
+  void invalidate();
+  // Replays the recorded frame (or uploads the raster backend's frame) into
+  // the intermediate texture.  Called by compositeIntermediate(); call it
+  // earlier to draw on top with the renderer directly.
+  void flushRecorded();
+  const DirtyRectStats& getDirtyRectStats() const { return dirtyRectStats; }
+
   void clearScreen();
 
+  // renderIntermediate() is compositeIntermediate() followed by present(); the
+  // two halves are public so the frame can be timed in phases.
+  void compositeIntermediate();
+  void present();
   void renderIntermediate();
 };
 
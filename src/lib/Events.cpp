@@ -46,6 +46,18 @@ bool Events::isCtrl() const {
   return isKeyPressed("Left Ctrl") || isKeyPressed("Right Ctrl");
 }
 
+bool Events::isInputHeld() const {
+  if (isMouseDown || isRightMouseDown || isMiddleMouseDown) {
+    return true;
+  }
+  for (const auto& it : keys) {
+    if (it.second) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void Events::pushRoute() { routes.push(std::make_unique<EventRoute>()); }
 void Events::pushRouteNextTick() { shouldPushRoute = true; }
 void Events::popRoute() {
@@ -63,6 +63,8 @@ public:
   ~Events();
   bool isKeyPressed(std::string_view name) const;
   bool isCtrl() const;
+  // any key or mouse button is down
+  bool isInputHeld() const;
 
   void pushRoute();
   void pushRouteNextTick();
@@ -0,0 +1,92 @@
+#include "FrameClock.h"
+#include "Logger.h"
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+namespace sdl2w {
+
+FrameClock::FrameClock() {
+  freq = SDL_GetPerformanceFrequency();
+  if (freq == 0) {
+    freq = 1;
+  }
+}
+
+void FrameClock::useRealTime() {
+  mode = CLOCK_REAL;
+  lastCounter = SDL_GetPerformanceCounter();
+}
+
+void FrameClock::useFixedStep(double stepMs) {
+  mode = CLOCK_FIXED;
+  fixedStepMs = stepMs;
+}
+
+void FrameClock::useReplay(const std::vector<double>& frameTimesMs,
+                           bool loop) {
+  if (frameTimesMs.empty()) {
+    LOG(WARN) << "[sdl2w] Cannot replay an empty list of frame times."
+              << Logger::endl;
+    return;
+  }
+  mode = CLOCK_REPLAY;
+  replayFrameTimes = frameTimesMs;
+  replayIndex = 0;
+  replayLoop = loop;
+}
+
+void FrameClock::reset() {
+  lastCounter = SDL_GetPerformanceCounter();
+  replayIndex = 0;
+  elapsedMs = 0.;
+}
+
+void FrameClock::resync() { lastCounter = SDL_GetPerformanceCounter(); }
+
+double FrameClock::tick() {
+  double dt = 0.;
+  switch (mode) {
+  case CLOCK_REAL: {
+    const uint64_t counter = SDL_GetPerformanceCounter();
+    dt = static_cast<double>(counter - lastCounter) * 1000. /
+         static_cast<double>(freq);
+    lastCounter = counter;
+    break;
+  }
+  case CLOCK_FIXED:
+    dt = fixedStepMs;
+    break;
+  case CLOCK_REPLAY:
+    if (replayIndex >= replayFrameTimes.size() && replayLoop) {
+      replayIndex = 0;
+    }
+    if (replayIndex < replayFrameTimes.size()) {
+      dt = replayFrameTimes[replayIndex++];
+    }
+    break;
+  }
+
+  elapsedMs += dt;
+  if (recording) {
+    recordedFrameTimes.push_back(dt);
+  }
+  return dt;
+}
+
+bool FrameClock::isFinished() const {
+  return mode == CLOCK_REPLAY && !replayLoop &&
+         replayIndex >= replayFrameTimes.size();
+}
+
+void FrameClock::setRecording(bool enabled) {
+  recording = enabled;
+  if (enabled) {
+    recordedFrameTimes.clear();
+  }
+}
+
+} // namespace sdl2w
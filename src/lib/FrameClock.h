@@ -0,0 +1,61 @@
+// A FrameClock supplies the per-frame delta time to Window::renderLoop.  By
+// default it reads the wall clock, but it can instead advance a virtual clock
+// by a fixed step every frame, or replay a recorded list of frame times, which
+// makes headless runs deterministic and independent of how fast the machine
+// actually renders.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sdl2w {
+
+enum ClockMode {
+  CLOCK_REAL,
+  CLOCK_FIXED,
+  CLOCK_REPLAY,
+};
+
+class FrameClock {
+  ClockMode mode = CLOCK_REAL;
+  uint64_t freq = 1;
+  uint64_t lastCounter = 0;
+  double fixedStepMs = 1000. / 60.;
+  std::vector<double> replayFrameTimes;
+  size_t replayIndex = 0;
+  bool replayLoop = false;
+  double elapsedMs = 0.;
+  bool recording = false;
+  std::vector<double> recordedFrameTimes;
+
+public:
+  FrameClock();
+
+  void useRealTime();
+  void useFixedStep(double stepMs);
+  // When the list runs out the clock either starts over (loop) or reports
+  // isFinished(); Window stops its loop at that point.
+  void useReplay(const std::vector<double>& frameTimesMs, bool loop = false);
+  ClockMode getMode() const { return mode; }
+
+  // Restart timing from now; called when a render loop starts.
+  void reset();
+  // Start the next delta from now, dropping the time since the last tick,
+  // e.g. after the loop was suspended.
+  void resync();
+  // Advance one frame and return its delta in ms.
+  double tick();
+  // virtual time in ms since reset()
+  double getElapsedMs() const { return elapsedMs; }
+  bool isFinished() const;
+
+  // Record every delta returned by tick() so a run can be replayed later.
+  void setRecording(bool enabled);
+  const std::vector<double>& getRecordedFrameTimes() const {
+    return recordedFrameTimes;
+  }
+};
+
+} // namespace sdl2w
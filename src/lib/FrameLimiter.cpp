@@ -0,0 +1,66 @@
+#include "FrameLimiter.h"
+#include <algorithm>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+namespace sdl2w {
+
+FrameLimiter::FrameLimiter() {
+  freq = SDL_GetPerformanceFrequency();
+  if (freq == 0) {
+    freq = 1;
+  }
+}
+
+void FrameLimiter::setTargetFps(int fps) {
+  targetFps = std::max(0, fps);
+  frameTicks = targetFps > 0 ? freq / static_cast<uint64_t>(targetFps) : 0;
+  nextDeadline = 0;
+}
+
+void FrameLimiter::resetJitterStats() {
+  lastJitterMs = 0.;
+  avgJitterMs = 0.;
+  maxJitterMs = 0.;
+}
+
+void FrameLimiter::wait() {
+  if (targetFps <= 0) {
+    return;
+  }
+
+  uint64_t now = SDL_GetPerformanceCounter();
+  if (nextDeadline == 0) {
+    nextDeadline = now + frameTicks;
+  }
+
+  if (now < nextDeadline) {
+    const double remainingMs =
+        static_cast<double>(nextDeadline - now) * 1000. /
+        static_cast<double>(freq);
+    if (remainingMs > spinMarginMs) {
+      SDL_Delay(static_cast<Uint32>(remainingMs - spinMarginMs));
+    }
+    now = SDL_GetPerformanceCounter();
+    while (now < nextDeadline) {
+      now = SDL_GetPerformanceCounter();
+    }
+  }
+
+  lastJitterMs = static_cast<double>(now - nextDeadline) * 1000. /
+                 static_cast<double>(freq);
+  avgJitterMs = avgJitterMs * 0.95 + lastJitterMs * 0.05;
+  maxJitterMs = std::max(maxJitterMs, lastJitterMs);
+
+  nextDeadline += frameTicks;
+  if (now >= nextDeadline) {
+    // more than a frame behind; don't try to catch up with a burst of frames
+    nextDeadline = now + frameTicks;
+  }
+}
+
+} // namespace sdl2w
@@ -0,0 +1,45 @@
+// A FrameLimiter caps the main loop at a target frame rate.  It sleeps with
+// SDL_Delay until shortly before the frame deadline, then spins on
+// SDL_GetPerformanceCounter for the remainder, which avoids the coarse wakeups
+// of a plain sleep.  How late each frame actually started (jitter) is
+// measured so pacing can be checked.
+
+#pragma once
+
+#include <cstdint>
+
+namespace sdl2w {
+
+class FrameLimiter {
+  uint64_t freq = 1;
+  uint64_t frameTicks = 0;
+  uint64_t nextDeadline = 0;
+  int targetFps = 0;
+  double spinMarginMs = 2.0;
+  double lastJitterMs = 0.;
+  double avgJitterMs = 0.;
+  double maxJitterMs = 0.;
+
+public:
+  FrameLimiter();
+
+  // 0 disables the cap
+  void setTargetFps(int fps);
+  int getTargetFps() const { return targetFps; }
+  // how long before the deadline to stop sleeping and start spinning
+  void setSpinMarginMs(double ms) { spinMarginMs = ms; }
+  bool isEnabled() const { return targetFps > 0; }
+
+  // Blocks until the next frame deadline.  Call once per frame, after present.
+  void wait();
+  // Forget the current deadline, e.g. after the loop was paused.
+  void reset() { nextDeadline = 0; }
+
+  // jitter is how far past its deadline a frame was released, in ms
+  double getLastJitterMs() const { return lastJitterMs; }
+  double getAverageJitterMs() const { return avgJitterMs; }
+  double getMaxJitterMs() const { return maxJitterMs; }
+  void resetJitterStats();
+};
+
+} // namespace sdl2w
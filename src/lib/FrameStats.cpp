@@ -0,0 +1,121 @@
+#include "FrameStats.h"
+#include "AssetLoader.h"
+#include "Defines.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+namespace sdl2w {
+
+FrameStats::FrameStats(size_t capacity) : samples(capacity) {
+  if (capacity == 0) {
+    LOG_LINE(ERROR) << "[sdl2w] FrameStats capacity must be at least 1"
+                    << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+}
+
+void FrameStats::push(const FrameSample& sample) {
+  samples[head] = sample;
+  head = (head + 1) % samples.size();
+  count = std::min(count + 1, samples.size());
+  if (sample.totalMs > hitchThresholdMs) {
+    hitchCount++;
+  }
+}
+
+void FrameStats::clear() {
+  head = 0;
+  count = 0;
+  hitchCount = 0;
+}
+
+const FrameSample& FrameStats::get(size_t i) const {
+  const size_t oldest = (head + samples.size() - count) % samples.size();
+  return samples[(oldest + i) % samples.size()];
+}
+
+const FrameSample& FrameStats::getLatest() const {
+  if (count == 0) {
+    LOG_LINE(ERROR) << "[sdl2w] FrameStats::getLatest called with no samples"
+                    << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  return get(count - 1);
+}
+
+double FrameStats::getAverageMs() const {
+  if (count == 0) {
+    return 0.;
+  }
+  double sum = 0.;
+  for (size_t i = 0; i < count; i++) {
+    sum += get(i).totalMs;
+  }
+  return sum / static_cast<double>(count);
+}
+
+FrameStatsSummary FrameStats::summarize() const {
+  FrameStatsSummary summary;
+  summary.count = count;
+  if (count == 0) {
+    return summary;
+  }
+
+  std::vector<double> sorted;
+  sorted.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    sorted.push_back(get(i).totalMs);
+  }
+  std::sort(sorted.begin(), sorted.end());
+
+  // nearest-rank percentile
+  auto percentile = [&](double p) {
+    const size_t rank = static_cast<size_t>(
+        std::ceil(p / 100. * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+  };
+
+  summary.avgMs = getAverageMs();
+  summary.p50Ms = percentile(50.);
+  summary.p95Ms = percentile(95.);
+  summary.p99Ms = percentile(99.);
+  summary.maxMs = sorted.back();
+  return summary;
+}
+
+std::vector<FrameSample> FrameStats::getHitches() const {
+  std::vector<FrameSample> hitches;
+  for (size_t i = 0; i < count; i++) {
+    if (get(i).totalMs > hitchThresholdMs) {
+      hitches.push_back(get(i));
+    }
+  }
+  return hitches;
+}
+
+std::string FrameStats::toCsv() const {
+  std::stringstream ss;
+  ss << "frame,totalMs,eventsMs,updateMs,drawMs,presentMs,drawCalls,"
+        "textureSwitches,primitiveCalls,textCacheMisses,culledDraws,"
+        "renderScale\n";
+  for (size_t i = 0; i < count; i++) {
+    const FrameSample& s = get(i);
+    ss << s.frame << "," << s.totalMs << "," << s.eventsMs << ","
+       << s.updateMs << "," << s.drawMs << "," << s.presentMs << ","
+       << s.drawCalls << "," << s.textureSwitches << "," << s.primitiveCalls
+       << "," << s.textCacheMisses << "," << s.culledDraws << ","
+       << s.renderScale << "\n";
+  }
+  return ss.str();
+}
+
+void FrameStats::writeCsv(std::string_view path) const {
+  LOG(INFO) << "[sdl2w] Writing " << count << " frame samples to " << path
+            << Logger::endl;
+  saveFileAsString(path, toCsv());
+}
+
+} // namespace sdl2w
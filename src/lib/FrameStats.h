@@ -0,0 +1,79 @@
+// FrameStats keeps a fixed-size ring buffer of per-frame timing samples
+// recorded by Window::renderLoop, and summarizes them (average, percentiles,
+// hitches) for tracking frame time regressions between builds.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sdl2w {
+
+struct FrameSample {
+  uint64_t frame = 0;
+  // wall time from the start of this frame to the start of the next one
+  double totalMs = 0.;
+  double eventsMs = 0.;
+  // loopCb (or initializingCb), including the draw calls it makes
+  double updateMs = 0.;
+  // compositing the intermediate texture onto the backbuffer
+  double drawMs = 0.;
+  double presentMs = 0.;
+  // Draw counters for the frame (see DrawCounters)
+  int drawCalls = 0;
+  int textureSwitches = 0;
+  int primitiveCalls = 0;
+  int textCacheMisses = 0;
+  int culledDraws = 0;
+  // Draw::getRenderScale() for the frame
+  double renderScale = 1.;
+};
+
+struct FrameStatsSummary {
+  size_t count = 0;
+  double avgMs = 0.;
+  double p50Ms = 0.;
+  double p95Ms = 0.;
+  double p99Ms = 0.;
+  double maxMs = 0.;
+};
+
+class FrameStats {
+  std::vector<FrameSample> samples;
+  size_t head = 0;
+  size_t count = 0;
+  double hitchThresholdMs = 50.;
+  uint64_t hitchCount = 0;
+
+public:
+  // throws when capacity is 0
+  FrameStats(size_t capacity = 1024);
+
+  void push(const FrameSample& sample);
+  void clear();
+  size_t size() const { return count; }
+  size_t capacity() const { return samples.size(); }
+  // 0 is the oldest sample still in the buffer
+  const FrameSample& get(size_t i) const;
+  // the newest sample; throws while the buffer is empty
+  const FrameSample& getLatest() const;
+
+  // statistics over totalMs of the buffered samples
+  FrameStatsSummary summarize() const;
+  double getAverageMs() const;
+
+  // Frames whose totalMs is above the threshold.  The lifetime count keeps
+  // going after the samples have left the ring buffer.
+  void setHitchThresholdMs(double ms) { hitchThresholdMs = ms; }
+  double getHitchThresholdMs() const { return hitchThresholdMs; }
+  uint64_t getHitchCount() const { return hitchCount; }
+  std::vector<FrameSample> getHitches() const;
+
+  std::string toCsv() const;
+  void writeCsv(std::string_view path) const;
+};
+
+} // namespace sdl2w
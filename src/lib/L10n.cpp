@@ -1,6 +1,7 @@
 #include "L10n.h"
 #include "Defines.h"
 #include "Logger.h"
+#include "Profiler.h"
 #include <string_view>
 #include <unordered_map>
 
@@ -18,6 +19,7 @@ void L10n::init(const std::vector<std::string>& langs) {
   if (!isEnabled()) {
     return;
   }
+  SDL2W_ZONE("L10n::init");
 
   locStrings["default"] = std::unordered_map<size_t, std::string>();
 
@@ -49,6 +51,7 @@ void L10n::loadLanguage(std::string_view lang, std::string_view langText) {
   if (!isEnabled()) {
     return;
   }
+  SDL2W_ZONE("L10n::loadLanguage");
 
   const std::string langStr(lang);
   locStrings[langStr] = std::unordered_map<size_t, std::string>();
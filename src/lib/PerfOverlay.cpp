@@ -0,0 +1,176 @@
+#include "PerfOverlay.h"
+#include "Draw.h"
+#include "FrameStats.h"
+#include "SoftRaster.h"
+#include "Store.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#include <SDL2_gfxPrimitives.h>
+#else
+#include <SDL2/SDL.h>
+#include <SDL2/SDL2_gfxPrimitives.h>
+#endif
+
+namespace sdl2w {
+
+constexpr int OVERLAY_CHAR_SIZE = 8;
+constexpr int OVERLAY_LINE_HEIGHT = 10;
+constexpr int OVERLAY_PADDING = 4;
+constexpr int OVERLAY_GRAPH_HEIGHT = 40;
+constexpr int OVERLAY_BAR_WIDTH = 2;
+// frame time that fills the whole graph height
+constexpr double OVERLAY_GRAPH_MAX_MS = 50.;
+constexpr double OVERLAY_BUDGET_MS = 1000. / 60.;
+
+// the renderer SDL2_gfx's glyph cache was filled with, if any
+static SDL_Renderer* glyphRenderer = nullptr;
+
+PerfOverlay::PerfOverlay(Draw& drawA, Store& storeA)
+    : draw(drawA), store(storeA) {}
+
+void PerfOverlay::refreshText(const FrameStats& stats) {
+  const FrameStatsSummary summary = stats.summarize();
+  const DrawCounters& counters = draw.getCounters();
+  const StoreMemoryUsage memory = store.getMemoryUsage();
+  const int textLookups = counters.textCacheHits + counters.textCacheMisses;
+  const double textHitPct =
+      textLookups > 0
+          ? 100. * static_cast<double>(counters.textCacheHits) / textLookups
+          : 100.;
+
+  lines.clear();
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1);
+  ss << "FPS " << (summary.avgMs > 0. ? 1000. / summary.avgMs : 0.) << "  "
+     << summary.avgMs << "ms  p99 " << summary.p99Ms << "ms";
+  lines.push_back(ss.str());
+  ss.str("");
+  ss << "draws " << counters.drawCalls << "  prims "
+     << counters.primitiveCalls << "  culled " << counters.culledDraws;
+  lines.push_back(ss.str());
+  ss.str("");
+  ss << "tex switches " << counters.textureSwitches;
+  if (draw.isAdaptiveResolution() || draw.getRenderScale() != 1.) {
+    ss << "  scale " << draw.getRenderScale();
+  }
+  if (draw.isRasterBackend()) {
+    ss << "  raster " << SoftRaster::getIsaName(SoftRaster::getIsa())
+       << " x" << draw.getRasterThreads();
+  }
+  lines.push_back(ss.str());
+  ss.str("");
+  ss << "text cache " << textHitPct << "% (" << counters.textCacheMisses
+     << " miss)";
+  lines.push_back(ss.str());
+  ss.str("");
+  ss << "store " << static_cast<double>(memory.getTotalBytes()) / 1048576.
+     << "MB  assets " << store.getResidentAssetCount();
+  lines.push_back(ss.str());
+  ss.str("");
+  ss << "hitches " << stats.getHitchCount() << " (>"
+     << stats.getHitchThresholdMs() << "ms)";
+  lines.push_back(ss.str());
+}
+
+void PerfOverlay::releaseGlyphs(SDL_Renderer* renderer) {
+  if (renderer == nullptr || renderer != glyphRenderer) {
+    return;
+  }
+  gfxPrimitivesSetFont(nullptr, 0, 0);
+  glyphRenderer = nullptr;
+}
+
+void PerfOverlay::render(const FrameStats& stats, double dt) {
+  msSinceRefresh += dt;
+  if (lines.empty() || msSinceRefresh >= refreshIntervalMs) {
+    refreshText(stats);
+    msSinceRefresh = 0.;
+  }
+
+  SDL_Renderer* renderer = draw.getSdlRenderer();
+  if (glyphRenderer != renderer) {
+    // cached glyphs can't be copied onto another renderer
+    releaseGlyphs(glyphRenderer);
+    glyphRenderer = renderer;
+  }
+  size_t maxLineLength = 0;
+  for (const auto& line : lines) {
+    maxLineLength = std::max(maxLineLength, line.size());
+  }
+  const int textH = static_cast<int>(lines.size()) * OVERLAY_LINE_HEIGHT;
+  const int graphW = GRAPH_SAMPLES * OVERLAY_BAR_WIDTH;
+  const int panelW =
+      std::max(graphW, static_cast<int>(maxLineLength) * OVERLAY_CHAR_SIZE) +
+      OVERLAY_PADDING * 2;
+  const int panelH = textH + OVERLAY_GRAPH_HEIGHT + OVERLAY_PADDING * 3;
+
+  SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 170);
+  const SDL_Rect panel = {x, y, panelW, panelH};
+  SDL_RenderFillRect(renderer, &panel);
+
+  for (size_t i = 0; i < lines.size(); i++) {
+    stringRGBA(renderer,
+               static_cast<Sint16>(x + OVERLAY_PADDING),
+               static_cast<Sint16>(y + OVERLAY_PADDING +
+                                   static_cast<int>(i) * OVERLAY_LINE_HEIGHT),
+               lines[i].c_str(),
+               255,
+               255,
+               255,
+               255);
+  }
+
+  // frame time graph, newest sample on the right
+  SDL_Rect okBars[GRAPH_SAMPLES];
+  SDL_Rect slowBars[GRAPH_SAMPLES];
+  int numOk = 0;
+  int numSlow = 0;
+  const int graphBottom =
+      y + OVERLAY_PADDING * 2 + textH + OVERLAY_GRAPH_HEIGHT;
+  const int numSamples =
+      std::min(GRAPH_SAMPLES, static_cast<int>(stats.size()));
+  for (int i = 0; i < numSamples; i++) {
+    const FrameSample& sample = stats.get(stats.size() - numSamples + i);
+    const int barH = std::clamp(
+        static_cast<int>(sample.totalMs / OVERLAY_GRAPH_MAX_MS *
+                         OVERLAY_GRAPH_HEIGHT),
+        1,
+        OVERLAY_GRAPH_HEIGHT);
+    const SDL_Rect bar = {
+        x + OVERLAY_PADDING + (GRAPH_SAMPLES - numSamples + i) *
+                                  OVERLAY_BAR_WIDTH,
+        graphBottom - barH,
+        OVERLAY_BAR_WIDTH,
+        barH,
+    };
+    if (sample.totalMs > OVERLAY_BUDGET_MS + 1.) {
+      slowBars[numSlow++] = bar;
+    } else {
+      okBars[numOk++] = bar;
+    }
+  }
+  SDL_SetRenderDrawColor(renderer, 80, 220, 80, 255);
+  SDL_RenderFillRects(renderer, okBars, numOk);
+  SDL_SetRenderDrawColor(renderer, 240, 70, 60, 255);
+  SDL_RenderFillRects(renderer, slowBars, numSlow);
+
+  const SDL_Rect budgetLine = {
+      x + OVERLAY_PADDING,
+      graphBottom - static_cast<int>(OVERLAY_BUDGET_MS / OVERLAY_GRAPH_MAX_MS *
+                                     OVERLAY_GRAPH_HEIGHT),
+      graphW,
+      1,
+  };
+  SDL_SetRenderDrawColor(renderer, 240, 220, 60, 255);
+  SDL_RenderFillRect(renderer, &budgetLine);
+
+  const SDL_Color& bg = draw.getBackgroundColor();
+  SDL_SetRenderDrawColor(renderer, bg.r, bg.g, bg.b, bg.a);
+}
+
+} // namespace sdl2w
@@ -0,0 +1,53 @@
+// The PerfOverlay is a performance HUD that Window draws on top of the frame,
+// after loopCb and before the intermediate texture is composited.  It shows a
+// frame time graph, FPS, draw counters, text cache hit rate and Store usage.
+//
+// It draws with SDL2_gfx's built-in bitmap font and batched fill rects
+// straight on the renderer rather than through Draw, which keeps it out of
+// the counters it reports.  The text costs one texture copy per character per
+// frame: SDL2_gfx renders each glyph into a texture the first time it is
+// drawn and keeps it in a process-wide cache tied to that renderer.  The
+// cache is flushed when another renderer draws the overlay, and Window
+// flushes it with releaseGlyphs() before its renderer goes away.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct SDL_Renderer;
+
+namespace sdl2w {
+class Draw;
+class Store;
+class FrameStats;
+
+class PerfOverlay {
+  Draw& draw;
+  Store& store;
+  std::vector<std::string> lines;
+  double msSinceRefresh = 0.;
+  double refreshIntervalMs = 250.;
+  int x = 4;
+  int y = 4;
+
+  void refreshText(const FrameStats& stats);
+
+public:
+  static constexpr int GRAPH_SAMPLES = 120;
+
+  PerfOverlay(Draw& drawA, Store& storeA);
+
+  void setPosition(int xA, int yA) {
+    x = xA;
+    y = yA;
+  }
+  // the text is only rebuilt this often so it stays readable (and cheap)
+  void setRefreshIntervalMs(double ms) { refreshIntervalMs = ms; }
+
+  void render(const FrameStats& stats, double dt);
+  // Frees SDL2_gfx's glyph textures if they were created with this renderer.
+  static void releaseGlyphs(SDL_Renderer* renderer);
+};
+
+} // namespace sdl2w
@@ -0,0 +1,297 @@
+#include "Profiler.h"
+#include "AssetLoader.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+namespace sdl2w {
+
+namespace {
+
+struct ProfileEvent {
+  const char* name;
+  uint64_t start;
+  uint64_t end;
+};
+
+// Only the owning thread writes events; count is published with release so a
+// reader that acquires it sees every event below it.
+struct ThreadBuffer {
+  int tid = 0;
+  std::vector<ProfileEvent> events;
+  std::atomic<size_t> count{0};
+  std::atomic<uint64_t> dropped{0};
+};
+
+std::mutex registryMutex;
+// never freed, so the events of finished threads can still be dumped
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+size_t threadBufferCapacity = 1 << 18;
+std::string atExitPath;
+thread_local ThreadBuffer* localBuffer = nullptr;
+
+ThreadBuffer* getLocalBuffer() {
+  if (localBuffer == nullptr) {
+    auto buffer = std::make_unique<ThreadBuffer>();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->tid = static_cast<int>(registry.size()) + 1;
+    buffer->events.resize(threadBufferCapacity);
+    localBuffer = buffer.get();
+    registry.push_back(std::move(buffer));
+  }
+  return localBuffer;
+}
+
+template <typename Fn> void forEachEvent(Fn fn) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for (const auto& buffer : registry) {
+    const size_t n = buffer->count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < n; i++) {
+      fn(*buffer, buffer->events[i]);
+    }
+  }
+}
+
+void writeTraceOnExit() { Profiler::writeTrace(atExitPath); }
+
+// Startup capture, only touched by the thread that called beginStartup.
+// Capped, since a program that never presents a frame (a benchmark, a tool)
+// would otherwise capture forever.
+constexpr size_t STARTUP_EVENT_CAPACITY = 1 << 16;
+bool startupBegun = false;
+uint64_t startupBegin = 0;
+double timeToFirstFrameMs = 0.;
+std::thread::id startupThread;
+std::vector<ProfileEvent> startupEvents;
+uint64_t startupDropped = 0;
+
+double countsToMs(uint64_t counts) {
+  return static_cast<double>(counts) * 1000. /
+         static_cast<double>(SDL_GetPerformanceFrequency());
+}
+
+} // namespace
+
+void Profiler::setEnabled(bool enabledA) {
+  if (enabledA) {
+    flags.fetch_or(FLAG_ENABLED, std::memory_order_relaxed);
+  } else {
+    flags.fetch_and(~FLAG_ENABLED, std::memory_order_relaxed);
+  }
+}
+
+void Profiler::setThreadBufferCapacity(size_t capacity) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  threadBufferCapacity = std::max<size_t>(1, capacity);
+}
+
+uint64_t Profiler::now() { return SDL_GetPerformanceCounter(); }
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+  const int currentFlags = flags.load(std::memory_order_acquire);
+  if ((currentFlags & FLAG_STARTUP) &&
+      std::this_thread::get_id() == startupThread) {
+    if (startupEvents.size() < STARTUP_EVENT_CAPACITY) {
+      startupEvents.push_back(ProfileEvent{name, start, end});
+    } else {
+      startupDropped++;
+    }
+  }
+  if (!(currentFlags & FLAG_ENABLED)) {
+    return;
+  }
+
+  ThreadBuffer* buffer = getLocalBuffer();
+  const size_t i = buffer->count.load(std::memory_order_relaxed);
+  if (i >= buffer->events.size()) {
+    buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer->events[i] = ProfileEvent{name, start, end};
+  buffer->count.store(i + 1, std::memory_order_release);
+}
+
+void Profiler::clear() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for (const auto& buffer : registry) {
+    buffer->count.store(0, std::memory_order_release);
+    buffer->dropped.store(0, std::memory_order_relaxed);
+  }
+  startupEvents.clear();
+  startupEvents.shrink_to_fit();
+  startupDropped = 0;
+}
+
+std::string Profiler::toTraceJson() {
+  const double usPerCount =
+      1000000. / static_cast<double>(SDL_GetPerformanceFrequency());
+  uint64_t origin = UINT64_MAX;
+  forEachEvent([&](const ThreadBuffer&, const ProfileEvent& event) {
+    origin = std::min(origin, event.start);
+  });
+
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(3);
+  ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  forEachEvent([&](const ThreadBuffer& buffer, const ProfileEvent& event) {
+    // names are code literals, so the only characters that need escaping in
+    // practice are quotes and backslashes
+    std::string name = event.name;
+    for (size_t i = 0; i < name.size(); i++) {
+      if (name[i] == '"' || name[i] == '\\') {
+        name.insert(i++, 1, '\\');
+      }
+    }
+    ss << (first ? "" : ",") << "\n{\"name\":\"" << name
+       << "\",\"cat\":\"sdl2w\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+       << buffer.tid
+       << ",\"ts\":" << static_cast<double>(event.start - origin) * usPerCount
+       << ",\"dur\":"
+       << static_cast<double>(event.end - event.start) * usPerCount << "}";
+    first = false;
+  });
+  ss << "\n]}\n";
+  return ss.str();
+}
+
+void Profiler::writeTrace(std::string_view path) {
+  size_t numEvents = 0;
+  uint64_t numDropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& buffer : registry) {
+      numEvents += buffer->count.load(std::memory_order_acquire);
+      numDropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+  }
+  LOG(INFO) << "[sdl2w] Writing " << numEvents << " profile events to " << path
+            << Logger::endl;
+  if (numDropped > 0) {
+    LOG(WARN) << "[sdl2w] " << numDropped
+              << " profile events were dropped, increase the thread buffer "
+                 "capacity"
+              << Logger::endl;
+  }
+  saveFileAsString(path, toTraceJson());
+}
+
+void Profiler::writeTraceAtExit(std::string_view path) {
+  const bool registered = !atExitPath.empty();
+  atExitPath = std::string(path);
+  if (!registered) {
+    std::atexit(writeTraceOnExit);
+  }
+}
+
+void Profiler::beginStartup() {
+  if (startupBegun) {
+    return;
+  }
+  startupBegun = true;
+  startupBegin = now();
+  startupThread = std::this_thread::get_id();
+  startupEvents.reserve(4096);
+  flags.fetch_or(FLAG_STARTUP, std::memory_order_release);
+}
+
+void Profiler::endStartup() {
+  if (!isCapturingStartup()) {
+    return;
+  }
+  flags.fetch_and(~FLAG_STARTUP, std::memory_order_relaxed);
+  timeToFirstFrameMs = countsToMs(now() - startupBegin);
+  LOG(INFO) << getStartupReport() << Logger::endl;
+}
+
+double Profiler::getTimeToFirstFrameMs() { return timeToFirstFrameMs; }
+
+std::vector<StartupPhase> Profiler::getStartupPhases() {
+  // Zones are recorded when they end, so sort them back into start order and
+  // rebuild the nesting to split each one's time between itself and its
+  // children.
+  std::vector<ProfileEvent> events = startupEvents;
+  std::sort(events.begin(),
+            events.end(),
+            [](const ProfileEvent& a, const ProfileEvent& b) {
+              return a.start != b.start ? a.start < b.start : a.end > b.end;
+            });
+  std::vector<double> childMs(events.size(), 0.);
+  std::vector<int> depths(events.size(), 0);
+  std::vector<size_t> open;
+  for (size_t i = 0; i < events.size(); i++) {
+    while (!open.empty() && events[open.back()].end <= events[i].start) {
+      open.pop_back();
+    }
+    if (!open.empty()) {
+      childMs[open.back()] += countsToMs(events[i].end - events[i].start);
+    }
+    depths[i] = static_cast<int>(open.size());
+    open.push_back(i);
+  }
+
+  std::vector<StartupPhase> phases;
+  std::map<std::string, size_t> phaseIndex;
+  for (size_t i = 0; i < events.size(); i++) {
+    auto [it, inserted] = phaseIndex.try_emplace(events[i].name, phases.size());
+    if (inserted) {
+      phases.push_back(
+          StartupPhase{.name = events[i].name, .depth = depths[i]});
+    }
+    StartupPhase& phase = phases[it->second];
+    const double ms = countsToMs(events[i].end - events[i].start);
+    phase.count++;
+    phase.totalMs += ms;
+    phase.selfMs += ms - childMs[i];
+  }
+  return phases;
+}
+
+std::string Profiler::getStartupReport() {
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1);
+  ss << "[sdl2w] Startup: " << timeToFirstFrameMs << "ms to first frame";
+  if (startupDropped > 0) {
+    ss << " (" << startupDropped << " zones past the first "
+       << STARTUP_EVENT_CAPACITY << " not captured)";
+  }
+  for (const StartupPhase& phase : getStartupPhases()) {
+    ss << "\n[sdl2w]   " << std::string(phase.depth * 2, ' ') << phase.name
+       << " " << phase.totalMs << "ms";
+    if (phase.selfMs + 0.05 < phase.totalMs) {
+      ss << " (self " << phase.selfMs << "ms)";
+    }
+    if (phase.count > 1) {
+      ss << " x" << phase.count;
+    }
+  }
+  return ss.str();
+}
+
+std::map<std::string, ProfileZoneTotal> Profiler::getZoneTotals() {
+  const double msPerCount =
+      1000. / static_cast<double>(SDL_GetPerformanceFrequency());
+  std::map<std::string, ProfileZoneTotal> totals;
+  forEachEvent([&](const ThreadBuffer&, const ProfileEvent& event) {
+    ProfileZoneTotal& total = totals[event.name];
+    const double ms = static_cast<double>(event.end - event.start) * msPerCount;
+    total.count++;
+    total.totalMs += ms;
+    total.maxMs = std::max(total.maxMs, ms);
+  });
+  return totals;
+}
+
+} // namespace sdl2w
@@ -0,0 +1,133 @@
+// Scoped profiling zones.  SDL2W_ZONE("name") times the rest of the enclosing
+// scope and records it into a buffer owned by the calling thread, so
+// recording never takes a lock.  Buffers are dumped as Chrome trace event
+// JSON, which chrome://tracing and https://ui.perfetto.dev can open.
+//
+// Recording is off until Profiler::setEnabled(true); a disabled zone costs a
+// relaxed atomic load.  Define SDL2W_NO_PROFILING (make PROFILING=false) to
+// compile zones out entirely.
+//
+// Independently of that, zones on the main thread are captured from
+// Window::init (or an earlier beginStartup()) until the first frame has been
+// presented, and logged as a startup report with the time to first frame.
+// WindowInitParams::startupReport turns this off for programs that never
+// present a frame; either way the capture stops growing after 65536 zones.
+//
+// Zone names must be string literals (or otherwise outlive the profiler);
+// only the pointer is stored.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sdl2w {
+
+struct ProfileZoneTotal {
+  uint64_t count = 0;
+  double totalMs = 0.;
+  double maxMs = 0.;
+};
+
+struct StartupPhase {
+  std::string name;
+  // nesting level of the first occurrence, for indenting the report
+  int depth = 0;
+  uint64_t count = 0;
+  double totalMs = 0.;
+  // total minus the time spent in zones nested inside it
+  double selfMs = 0.;
+};
+
+class Profiler {
+  static constexpr int FLAG_ENABLED = 1;
+  static constexpr int FLAG_STARTUP = 2;
+  inline static std::atomic<int> flags{0};
+
+public:
+  static void setEnabled(bool enabledA);
+  static bool isEnabled() {
+    return (flags.load(std::memory_order_relaxed) & FLAG_ENABLED) != 0;
+  }
+  // true when a zone has anywhere to go (trace buffers or startup capture)
+  static bool isRecording() {
+    return flags.load(std::memory_order_relaxed) != 0;
+  }
+  // Events each thread can hold before new ones are dropped.  Only affects
+  // threads that have not recorded anything yet.
+  static void setThreadBufferCapacity(size_t capacity);
+
+  static uint64_t now();
+  static void record(const char* name, uint64_t start, uint64_t end);
+  // Discards recorded events, including the startup capture.  Call while no
+  // other thread is recording.
+  static void clear();
+
+  static std::string toTraceJson();
+  static void writeTrace(std::string_view path);
+  // write the trace to path when the program exits
+  static void writeTraceAtExit(std::string_view path);
+  // aggregate of every recorded event, by zone name
+  static std::map<std::string, ProfileZoneTotal> getZoneTotals();
+
+  // Starts the startup capture on the calling thread.  Window::init calls
+  // this if it hasn't been called yet; call it first thing in main to include
+  // static init and argument parsing in the time to first frame.
+  static void beginStartup();
+  // Ends the capture and logs the report.  Called by Window::renderLoop after
+  // the first frame.
+  static void endStartup();
+  static bool isCapturingStartup() {
+    return (flags.load(std::memory_order_relaxed) & FLAG_STARTUP) != 0;
+  }
+  // from beginStartup to the end of the first frame, 0 until then
+  static double getTimeToFirstFrameMs();
+  // in order of first occurrence
+  static std::vector<StartupPhase> getStartupPhases();
+  static std::string getStartupReport();
+};
+
+class ProfileZone {
+  const char* name;
+  uint64_t start = 0;
+  bool active;
+
+public:
+  ProfileZone(const char* nameA)
+      : name(nameA), active(Profiler::isRecording()) {
+    if (active) {
+      start = Profiler::now();
+    }
+  }
+  ~ProfileZone() {
+    if (active) {
+      Profiler::record(name, start, Profiler::now());
+    }
+  }
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+} // namespace sdl2w
+
+#define SDL2W_ZONE_CONCAT_INNER(a, b) a##b
+#define SDL2W_ZONE_CONCAT(a, b) SDL2W_ZONE_CONCAT_INNER(a, b)
+#ifdef SDL2W_NO_PROFILING
+#define SDL2W_ZONE(name) ((void)0)
+#define SDL2W_ZONE_SPAN(name, start, end) ((void)0)
+#else
+#define SDL2W_ZONE(name)                                                       \
+  sdl2w::ProfileZone SDL2W_ZONE_CONCAT(sdl2wZone, __LINE__)(name)
+// records a span from two Profiler::now() (SDL perf counter) timestamps the
+// caller already took
+#define SDL2W_ZONE_SPAN(name, start, end)                                      \
+  do {                                                                         \
+    if (sdl2w::Profiler::isRecording()) {                                      \
+      sdl2w::Profiler::record(name, start, end);                               \
+    }                                                                          \
+  } while (0)
+#endif
@@ -0,0 +1,118 @@
+#include "RenderLayer.h"
+#include "Draw.h"
+#include "Logger.h"
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+namespace sdl2w {
+
+RenderLayer::RenderLayer(Draw& drawA, int widthA, int heightA)
+    : draw(drawA), width(widthA), height(heightA) {
+  createTexture();
+}
+
+RenderLayer::~RenderLayer() {
+  if (drawing) {
+    LOG(WARN) << "[sdl2w] RenderLayer destroyed between begin() and end()"
+              << Logger::endl;
+    draw.popRenderTarget();
+  }
+}
+
+void RenderLayer::createTexture() {
+  if (width <= 0 || height <= 0) {
+    LOG_LINE(ERROR) << "[sdl2w] Invalid RenderLayer size: " << width << "x"
+                    << height << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  SDL_Texture* texPtr = SDL_CreateTexture(draw.getSdlRenderer(),
+                                          SDL_PIXELFORMAT_RGBA32,
+                                          SDL_TEXTUREACCESS_TARGET,
+                                          width,
+                                          height);
+  if (texPtr == nullptr) {
+    LOG_LINE(ERROR) << "[sdl2w] Could not create RenderLayer texture: "
+                    << SDL_GetError() << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  tex.reset(texPtr);
+  dirty = true;
+}
+
+bool RenderLayer::begin(bool force) {
+  if (drawing) {
+    LOG(WARN) << "[sdl2w] RenderLayer::begin() called twice without end()"
+              << Logger::endl;
+    return false;
+  }
+  if (!dirty && !force) {
+    return false;
+  }
+  draw.pushRenderTarget(tex.get(), width, height, true);
+  drawing = true;
+  return true;
+}
+
+void RenderLayer::end() {
+  if (!drawing) {
+    LOG(WARN) << "[sdl2w] RenderLayer::end() called without begin()"
+              << Logger::endl;
+    return;
+  }
+  draw.popRenderTarget();
+  drawing = false;
+  dirty = false;
+}
+
+void RenderLayer::resize(int widthA, int heightA) {
+  if (widthA == width && heightA == height) {
+    return;
+  }
+  if (drawing) {
+    LOG_LINE(ERROR) << "[sdl2w] Cannot resize a RenderLayer while drawing "
+                       "into it"
+                    << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  width = widthA;
+  height = heightA;
+  createTexture();
+}
+
+void RenderLayer::composite(const LayerCompositeParams& params) {
+  if (drawing) {
+    LOG(WARN) << "[sdl2w] Cannot composite a RenderLayer into itself"
+              << Logger::endl;
+    return;
+  }
+  const Camera camera = draw.getCamera();
+  const int globalAlpha = draw.getGlobalAlpha();
+  if (!params.useCamera) {
+    draw.resetCamera();
+  }
+  draw.setGlobalAlpha(globalAlpha * params.alpha / 255);
+  draw.drawTexture(tex.get(),
+                   RenderableParamsEx{.scale = params.scale,
+                                      .angleDeg = params.angleDeg,
+                                      .x = params.x,
+                                      .y = params.y,
+                                      .w = width,
+                                      .h = height,
+                                      .clipX = 0,
+                                      .clipY = 0,
+                                      .clipW = width,
+                                      .clipH = height,
+                                      .centered = params.centered,
+                                      .flipped = false,
+                                      .premultipliedAlpha = true});
+  draw.setGlobalAlpha(globalAlpha);
+  if (!params.useCamera) {
+    draw.setCamera(camera);
+  }
+}
+
+} // namespace sdl2w
@@ -0,0 +1,80 @@
+// A RenderLayer is an offscreen texture that Draw calls can be redirected
+// into, composited into the frame later with its own transform and alpha.
+// Content that rarely changes (HUDs, menus, backgrounds) is drawn once and
+// then costs a single copy per frame; markDirty() when it has to be drawn
+// again.
+//
+//   if (hud.begin()) {
+//     draw.drawText("Score", {...});
+//     hud.end();
+//   }
+//   hud.composite({.x = 8, .y = 8});
+//
+// Between begin() and end() the Draw camera is reset, so coordinates are
+// pixels of the layer.  Layers can be nested.
+//
+// Whatever is drawn into the transparent layer ends up premultiplied by
+// alpha, and composite() blends it as such.  The SDL software renderer
+// (DrawMode::CPU) can't, so partly transparent pixels of a layer come out
+// darker there unless the raster backend (Window2Params::rasterBackend) is
+// used.
+//
+// Target textures lose their contents when the renderer is reset (an
+// SDL_RENDER_TARGETS_RESET event); mark every layer dirty when that happens.
+
+#pragma once
+
+#include "Defines.h"
+#include <memory>
+#include <utility>
+
+namespace sdl2w {
+class Draw;
+
+struct LayerCompositeParams {
+  int x = 0;
+  int y = 0;
+  std::pair<double, double> scale = {1., 1.};
+  double angleDeg = 0.;
+  // multiplied with the Draw global alpha
+  int alpha = 255;
+  bool centered = false;
+  // false draws the layer in screen space, ignoring the Draw camera
+  bool useCamera = false;
+};
+
+class RenderLayer {
+  Draw& draw;
+  std::unique_ptr<SDL_Texture, SDL_Deleter> tex;
+  int width = 0;
+  int height = 0;
+  bool dirty = true;
+  bool drawing = false;
+
+  void createTexture();
+
+public:
+  RenderLayer(Draw& drawA, int widthA, int heightA);
+  ~RenderLayer();
+  RenderLayer(const RenderLayer&) = delete;
+  RenderLayer& operator=(const RenderLayer&) = delete;
+
+  // Starts drawing into the layer, cleared to transparent, and returns true
+  // when it is dirty or force is set.  Returns false, redirecting nothing,
+  // when the previous contents are still valid.  Every begin() that returns
+  // true must be matched with end().
+  bool begin(bool force = false);
+  void end();
+
+  void markDirty() { dirty = true; }
+  bool isDirty() const { return dirty; }
+
+  // Recreates the texture, which marks the layer dirty.
+  void resize(int widthA, int heightA);
+  std::pair<int, int> getSize() const { return {width, height}; }
+  SDL_Texture* getTexture() const { return tex.get(); }
+
+  void composite(const LayerCompositeParams& params);
+};
+
+} // namespace sdl2w
@@ -0,0 +1,308 @@
+#include "RendererProbe.h"
+#include "AssetLoader.h"
+#include "Defines.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+namespace sdl2w {
+
+namespace {
+constexpr int PROBE_WARMUP_FRAMES = 2;
+constexpr int PROBE_FRAMES = 8;
+constexpr int PROBE_SPRITES = 1000;
+constexpr int PROBE_RECTS = 200;
+constexpr int PROBE_SPRITE_SIZE = 32;
+// Accelerated drivers also take load off the CPU, so software has to be
+// clearly faster to be picked.
+constexpr double PROBE_SOFTWARE_MARGIN = 0.9;
+
+SDL_Texture* createProbeSprite(SDL_Renderer* renderer) {
+  SDL_Surface* surf = SDL_CreateRGBSurfaceWithFormat(
+      0, PROBE_SPRITE_SIZE, PROBE_SPRITE_SIZE, 32, SDL_PIXELFORMAT_RGBA32);
+  if (surf == nullptr) {
+    return nullptr;
+  }
+  // a checker with transparent cells, so blending isn't trivial
+  const int cell = PROBE_SPRITE_SIZE / 4;
+  for (int y = 0; y < 4; y++) {
+    for (int x = 0; x < 4; x++) {
+      SDL_Rect rect = {x * cell, y * cell, cell, cell};
+      const Uint8 alpha = (x + y) % 2 == 0 ? 255 : 0;
+      SDL_FillRect(surf, &rect, SDL_MapRGBA(surf->format, 200, 80, 40, alpha));
+    }
+  }
+  SDL_Texture* tex = SDL_CreateTextureFromSurface(renderer, surf);
+  SDL_FreeSurface(surf);
+  if (tex != nullptr) {
+    SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+  }
+  return tex;
+}
+} // namespace
+
+std::string RendererProbe::getCacheKey(int width, int height) {
+  std::stringstream ss;
+  const char* videoDriver = SDL_GetCurrentVideoDriver();
+  ss << (videoDriver != nullptr ? videoDriver : "none") << ";" << width << "x"
+     << height;
+  const int numDrivers = SDL_GetNumRenderDrivers();
+  for (int i = 0; i < numDrivers; i++) {
+    SDL_RendererInfo info;
+    if (SDL_GetRenderDriverInfo(i, &info) == 0) {
+      ss << ";" << info.name << ":" << info.flags;
+    }
+  }
+  return ss.str();
+}
+
+bool RendererProbe::readCache(const std::string& path,
+                              const std::string& key,
+                              std::string& driver) {
+  std::ifstream file(std::string(ASSETS_PREFIX) + path);
+  if (!file) {
+    return false;
+  }
+  // <key>,<driver> per line
+  std::string line;
+  while (std::getline(file, line)) {
+    const size_t comma = line.rfind(',');
+    if (comma != std::string::npos && line.substr(0, comma) == key) {
+      driver = trim(line.substr(comma + 1));
+      return !driver.empty();
+    }
+  }
+  return false;
+}
+
+void RendererProbe::writeCache(const std::string& path,
+                               const std::string& key,
+                               const std::string& driver) {
+  std::stringstream ss;
+  std::ifstream file(std::string(ASSETS_PREFIX) + path);
+  std::string line;
+  while (file && std::getline(file, line)) {
+    const size_t comma = line.rfind(',');
+    if (comma != std::string::npos && line.substr(0, comma) != key) {
+      ss << line << "\n";
+    }
+  }
+  file.close();
+  ss << key << "," << driver << "\n";
+  try {
+    saveFileAsString(path, ss.str());
+  } catch (const std::runtime_error&) {
+    // only costs a benchmark on the next start
+    LOG(WARN) << "[sdl2w] Could not cache the renderer choice in " << path
+              << Logger::endl;
+  }
+}
+
+double RendererProbe::measure(SDL_Window* window,
+                              int driverIndex,
+                              bool software,
+                              int width,
+                              int height) {
+  SDL_Surface* softwareSurface = nullptr;
+  SDL_Renderer* renderer = nullptr;
+  if (software) {
+    softwareSurface = SDL_CreateRGBSurfaceWithFormat(
+        0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (softwareSurface != nullptr) {
+      renderer = SDL_CreateSoftwareRenderer(softwareSurface);
+    }
+  } else {
+    renderer =
+        SDL_CreateRenderer(window, driverIndex, SDL_RENDERER_TARGETTEXTURE);
+  }
+  if (renderer == nullptr) {
+    LOG(DEBUG) << "[sdl2w] Renderer probe could not create renderer: "
+               << SDL_GetError() << Logger::endl;
+    if (softwareSurface != nullptr) {
+      SDL_FreeSurface(softwareSurface);
+    }
+    return -1.;
+  }
+
+  // the frame is drawn into one target and composited into another, like
+  // Draw does with its intermediate texture
+  SDL_Texture* frame = SDL_CreateTexture(renderer,
+                                         SDL_PIXELFORMAT_ARGB8888,
+                                         SDL_TEXTUREACCESS_TARGET,
+                                         width,
+                                         height);
+  SDL_Texture* backbuffer = SDL_CreateTexture(renderer,
+                                              SDL_PIXELFORMAT_ARGB8888,
+                                              SDL_TEXTUREACCESS_TARGET,
+                                              width,
+                                              height);
+  SDL_Texture* sprite = createProbeSprite(renderer);
+
+  double frameMs = -1.;
+  if (frame != nullptr && backbuffer != nullptr && sprite != nullptr) {
+    const double msPerCount =
+        1000. / static_cast<double>(SDL_GetPerformanceFrequency());
+    std::vector<double> times;
+    for (int f = 0; f < PROBE_WARMUP_FRAMES + PROBE_FRAMES; f++) {
+      const uint64_t start = SDL_GetPerformanceCounter();
+      SDL_SetRenderTarget(renderer, frame);
+      SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+      SDL_RenderClear(renderer);
+      for (int i = 0; i < PROBE_SPRITES; i++) {
+        // every fourth sprite is rotated and scaled up
+        const bool transformed = i % 4 == 0;
+        const int size =
+            transformed ? PROBE_SPRITE_SIZE * 2 : PROBE_SPRITE_SIZE;
+        SDL_Rect dst = {(i * 37 + f * 3) % width,
+                        (i * 53 + f * 2) % height,
+                        size,
+                        size};
+        SDL_RenderCopyEx(renderer,
+                         sprite,
+                         nullptr,
+                         &dst,
+                         transformed ? (i * 7 + f) % 360 : 0.,
+                         nullptr,
+                         SDL_FLIP_NONE);
+      }
+      SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+      for (int i = 0; i < PROBE_RECTS; i++) {
+        SDL_Rect rect = {(i * 41) % width, (i * 29) % height, 24, 16};
+        SDL_SetRenderDrawColor(renderer, 40, 200, 80, 160);
+        SDL_RenderFillRect(renderer, &rect);
+      }
+      SDL_SetRenderTarget(renderer, backbuffer);
+      SDL_RenderCopy(renderer, frame, nullptr, nullptr);
+      // reading back a pixel waits for the GPU to finish the frame
+      SDL_Rect pixelRect = {0, 0, 1, 1};
+      Uint32 pixel = 0;
+      SDL_RenderReadPixels(renderer,
+                           &pixelRect,
+                           SDL_PIXELFORMAT_ARGB8888,
+                           &pixel,
+                           static_cast<int>(sizeof(pixel)));
+      const uint64_t end = SDL_GetPerformanceCounter();
+      if (f >= PROBE_WARMUP_FRAMES) {
+        times.push_back(static_cast<double>(end - start) * msPerCount);
+      }
+    }
+    std::sort(times.begin(), times.end());
+    frameMs = times[times.size() / 2];
+  } else {
+    LOG(DEBUG) << "[sdl2w] Renderer probe could not create textures: "
+               << SDL_GetError() << Logger::endl;
+  }
+
+  if (sprite != nullptr) {
+    SDL_DestroyTexture(sprite);
+  }
+  if (backbuffer != nullptr) {
+    SDL_DestroyTexture(backbuffer);
+  }
+  if (frame != nullptr) {
+    SDL_DestroyTexture(frame);
+  }
+  SDL_DestroyRenderer(renderer);
+  if (softwareSurface != nullptr) {
+    SDL_FreeSurface(softwareSurface);
+  }
+  return frameMs;
+}
+
+RendererChoice RendererProbe::choose(SDL_Window* window,
+                                     int width,
+                                     int height,
+                                     const std::string& cachePath) {
+  RendererChoice choice;
+#ifdef __EMSCRIPTEN__
+  // WebGL is the only accelerated option in a browser
+  choice.driver = "webgl";
+  return choice;
+#else
+  SDL2W_ZONE("RendererProbe::choose");
+
+  struct Candidate {
+    std::string name;
+    int index = -1;
+    bool software = false;
+  };
+  std::vector<Candidate> candidates;
+  const int numDrivers = SDL_GetNumRenderDrivers();
+  for (int i = 0; i < numDrivers; i++) {
+    SDL_RendererInfo info;
+    if (SDL_GetRenderDriverInfo(i, &info) != 0) {
+      continue;
+    }
+    const bool software = (info.flags & SDL_RENDERER_SOFTWARE) != 0;
+    candidates.push_back(
+        {.name = info.name, .index = software ? -1 : i, .software = software});
+  }
+
+  const std::string key = getCacheKey(width, height);
+  std::string cached;
+  if (!cachePath.empty() && readCache(cachePath, key, cached)) {
+    for (const Candidate& candidate : candidates) {
+      if (candidate.name == cached) {
+        choice.driver = candidate.name;
+        choice.driverIndex = candidate.index;
+        choice.software = candidate.software;
+        choice.fromCache = true;
+        LOG(INFO) << "[sdl2w] DrawMode::AUTO using cached renderer "
+                  << choice.driver << (choice.software ? " (CPU)" : " (GPU)")
+                  << Logger::endl;
+        return choice;
+      }
+    }
+  }
+
+  double bestMs = -1.;
+  for (const Candidate& candidate : candidates) {
+    const double ms = measure(
+        window, candidate.index, candidate.software, width, height);
+    choice.results.push_back({.driver = candidate.name,
+                              .software = candidate.software,
+                              .frameMs = ms});
+    LOG(INFO) << "[sdl2w] Renderer probe " << candidate.name << ": "
+              << (ms < 0. ? "unavailable" : std::to_string(ms) + "ms/frame")
+              << Logger::endl;
+    if (ms < 0.) {
+      continue;
+    }
+    const double weighted =
+        candidate.software ? ms / PROBE_SOFTWARE_MARGIN : ms;
+    if (bestMs < 0. || weighted < bestMs) {
+      bestMs = weighted;
+      choice.driver = candidate.name;
+      choice.driverIndex = candidate.index;
+      choice.software = candidate.software;
+    }
+  }
+
+  if (bestMs < 0.) {
+    // nothing could be measured; leave it to SDL
+    LOG(WARN) << "[sdl2w] Renderer probe failed for every driver, using GPU"
+              << Logger::endl;
+    return choice;
+  }
+  LOG(INFO) << "[sdl2w] DrawMode::AUTO picked " << choice.driver
+            << (choice.software ? " (CPU)" : " (GPU)") << Logger::endl;
+  if (!cachePath.empty()) {
+    writeCache(cachePath, key, choice.driver);
+  }
+  return choice;
+#endif
+}
+
+} // namespace sdl2w
@@ -0,0 +1,63 @@
+// RendererProbe resolves DrawMode::AUTO.  Every SDL render driver available
+// for the window renders a few frames of a representative workload (many
+// sprites, some rotated and scaled, filled rects and a full-screen composite)
+// into offscreen textures without presenting, and the fastest one is used.
+// The software driver renders into its own surface, so the window is never
+// touched by it.
+//
+// The choice is cached in a file keyed by the video driver, the list of
+// render drivers and the render size, so the benchmark only runs again when
+// one of those changes.  SDL doesn't expose the GPU model, so swapping the
+// GPU but keeping the drivers reuses the cached choice; delete the cache
+// file to measure again.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct SDL_Window;
+
+namespace sdl2w {
+
+struct RendererProbeResult {
+  std::string driver;
+  bool software = false;
+  // median ms per benchmark frame, < 0 when the driver could not be used
+  double frameMs = -1.;
+};
+
+struct RendererChoice {
+  std::string driver;
+  // SDL_CreateRenderer index of the driver, -1 for the software renderer
+  int driverIndex = -1;
+  bool software = false;
+  bool fromCache = false;
+  // empty when the choice came from the cache
+  std::vector<RendererProbeResult> results;
+};
+
+class RendererProbe {
+  static std::string getCacheKey(int width, int height);
+  static bool readCache(const std::string& path,
+                        const std::string& key,
+                        std::string& driver);
+  static void writeCache(const std::string& path,
+                         const std::string& key,
+                         const std::string& driver);
+  static double measure(SDL_Window* window,
+                        int driverIndex,
+                        bool software,
+                        int width,
+                        int height);
+
+public:
+  // cachePath is relative to ASSETS_PREFIX like other saved files; an empty
+  // path always benchmarks and caches nothing.
+  static RendererChoice choose(SDL_Window* window,
+                               int width,
+                               int height,
+                               const std::string& cachePath);
+};
+
+} // namespace sdl2w
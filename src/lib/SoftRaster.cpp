@@ -0,0 +1,893 @@
+#include "SoftRaster.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SDL2W_RASTER_X86
+#include <immintrin.h>
+// The AVX2 kernels are compiled for AVX2 on their own and only called after
+// checking the CPU, so the rest of the build keeps its baseline.
+#if defined(__GNUC__)
+#define SDL2W_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SDL2W_TARGET_AVX2
+#endif
+#endif
+
+namespace sdl2w {
+
+namespace {
+constexpr double PI = 3.14159265358979323846;
+
+// round(x / 255) for x <= 255 * 255, computed the same way by every kernel
+inline uint32_t div255(uint32_t x) {
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+uint32_t blendPixel(uint32_t d,
+                    uint32_t s,
+                    uint32_t alphaMod,
+                    bool premultiplied) {
+  const uint32_t sa = div255((s >> 24) * alphaMod);
+  const uint32_t f = premultiplied ? alphaMod : sa;
+  const uint32_t inv = 255 - sa;
+  uint32_t out = std::min(255u, sa + div255((d >> 24) * inv)) << 24;
+  for (int shift = 0; shift < 24; shift += 8) {
+    const uint32_t c =
+        div255((s >> shift & 0xff) * f) + div255((d >> shift & 0xff) * inv);
+    out |= std::min(255u, c) << shift;
+  }
+  return out;
+}
+
+uint32_t toPixel(const SDL_Color& c) {
+  return static_cast<uint32_t>(c.a) << 24 | static_cast<uint32_t>(c.r) << 16 |
+         static_cast<uint32_t>(c.g) << 8 | static_cast<uint32_t>(c.b);
+}
+
+struct Kernels {
+  // dst[i] = src[i] over dst[i]
+  void (*blendRow)(uint32_t* dst,
+                   const uint32_t* src,
+                   int n,
+                   uint32_t alphaMod,
+                   bool premultiplied);
+  // dst[i] = color over dst[i], with color not premultiplied
+  void (*fillRow)(uint32_t* dst, int n, uint32_t color);
+  // out[i] = src[idx[i]], transparent where idx[i] < 0
+  void (*gatherRow)(uint32_t* out,
+                    const uint32_t* src,
+                    const int32_t* idx,
+                    int n);
+};
+
+void blendRowScalar(uint32_t* dst,
+                    const uint32_t* src,
+                    int n,
+                    uint32_t alphaMod,
+                    bool premultiplied) {
+  for (int i = 0; i < n; i++) {
+    const uint32_t s = src[i];
+    // both shortcuts give exactly what blendPixel() would
+    if (s == 0) {
+      continue;
+    }
+    if (alphaMod == 255 && s >= 0xff000000) {
+      dst[i] = s;
+      continue;
+    }
+    dst[i] = blendPixel(dst[i], s, alphaMod, premultiplied);
+  }
+}
+
+void fillRowScalar(uint32_t* dst, int n, uint32_t color) {
+  if (color >= 0xff000000) {
+    std::fill(dst, dst + n, color);
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    dst[i] = blendPixel(dst[i], color, 255, false);
+  }
+}
+
+void gatherRowScalar(uint32_t* out,
+                     const uint32_t* src,
+                     const int32_t* idx,
+                     int n) {
+  for (int i = 0; i < n; i++) {
+    out[i] = idx[i] >= 0 ? src[idx[i]] : 0;
+  }
+}
+
+#ifdef SDL2W_RASTER_X86
+// The SIMD kernels widen pixels to one 16-bit lane per channel and run the
+// arithmetic of blendPixel() in every lane.
+
+inline __m128i div255Sse2(__m128i x) {
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// two widened pixels
+inline __m128i blendWideSse2(__m128i s,
+                             __m128i d,
+                             __m128i mod,
+                             bool premultiplied) {
+  const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+  const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xff), 0xff);
+  const __m128i sa = div255Sse2(_mm_mullo_epi16(a, mod));
+  // the alpha lane is scaled by the alpha mod, which yields sa
+  const __m128i f = premultiplied
+                        ? mod
+                        : _mm_or_si128(_mm_andnot_si128(alphaLanes, sa),
+                                       _mm_and_si128(alphaLanes, mod));
+  const __m128i inv = _mm_sub_epi16(_mm_set1_epi16(255), sa);
+  return _mm_add_epi16(div255Sse2(_mm_mullo_epi16(s, f)),
+                       div255Sse2(_mm_mullo_epi16(d, inv)));
+}
+
+void blendRowSse2(uint32_t* dst,
+                  const uint32_t* src,
+                  int n,
+                  uint32_t alphaMod,
+                  bool premultiplied) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000));
+  const __m128i mod = _mm_set1_epi16(static_cast<short>(alphaMod));
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i s =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xffff) {
+      continue;
+    }
+    __m128i* out = reinterpret_cast<__m128i*>(dst + i);
+    if (alphaMod == 255 &&
+        _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaMask),
+                                          alphaMask)) == 0xffff) {
+      _mm_storeu_si128(out, s);
+      continue;
+    }
+    const __m128i d = _mm_loadu_si128(out);
+    const __m128i lo = blendWideSse2(_mm_unpacklo_epi8(s, zero),
+                                     _mm_unpacklo_epi8(d, zero),
+                                     mod,
+                                     premultiplied);
+    const __m128i hi = blendWideSse2(_mm_unpackhi_epi8(s, zero),
+                                     _mm_unpackhi_epi8(d, zero),
+                                     mod,
+                                     premultiplied);
+    _mm_storeu_si128(out, _mm_packus_epi16(lo, hi));
+  }
+  blendRowScalar(dst + i, src + i, n - i, alphaMod, premultiplied);
+}
+
+void fillRowSse2(uint32_t* dst, int n, uint32_t color) {
+  if (color >= 0xff000000) {
+    std::fill(dst, dst + n, color);
+    return;
+  }
+  const __m128i zero = _mm_setzero_si128();
+  // color over transparent black is the premultiplied color
+  const __m128i p = _mm_unpacklo_epi8(
+      _mm_set1_epi32(static_cast<int>(blendPixel(0, color, 255, false))),
+      zero);
+  const __m128i inv = _mm_set1_epi16(static_cast<short>(255 - (color >> 24)));
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i* out = reinterpret_cast<__m128i*>(dst + i);
+    const __m128i d = _mm_loadu_si128(out);
+    const __m128i lo = _mm_add_epi16(
+        p, div255Sse2(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), inv)));
+    const __m128i hi = _mm_add_epi16(
+        p, div255Sse2(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), inv)));
+    _mm_storeu_si128(out, _mm_packus_epi16(lo, hi));
+  }
+  fillRowScalar(dst + i, n - i, color);
+}
+
+SDL2W_TARGET_AVX2 inline __m256i div255Avx2(__m256i x) {
+  x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+  return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+// four widened pixels
+SDL2W_TARGET_AVX2 inline __m256i blendWideAvx2(__m256i s,
+                                               __m256i d,
+                                               __m256i mod,
+                                               bool premultiplied) {
+  const __m256i alphaLanes = _mm256_set_epi16(
+      -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+  const __m256i a =
+      _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xff), 0xff);
+  const __m256i sa = div255Avx2(_mm256_mullo_epi16(a, mod));
+  const __m256i f = premultiplied
+                        ? mod
+                        : _mm256_or_si256(_mm256_andnot_si256(alphaLanes, sa),
+                                          _mm256_and_si256(alphaLanes, mod));
+  const __m256i inv = _mm256_sub_epi16(_mm256_set1_epi16(255), sa);
+  return _mm256_add_epi16(div255Avx2(_mm256_mullo_epi16(s, f)),
+                          div255Avx2(_mm256_mullo_epi16(d, inv)));
+}
+
+SDL2W_TARGET_AVX2 void blendRowAvx2(uint32_t* dst,
+                                    const uint32_t* src,
+                                    int n,
+                                    uint32_t alphaMod,
+                                    bool premultiplied) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xff000000));
+  const __m256i mod = _mm256_set1_epi16(static_cast<short>(alphaMod));
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i s =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    if (_mm256_testz_si256(s, s)) {
+      continue;
+    }
+    __m256i* out = reinterpret_cast<__m256i*>(dst + i);
+    if (alphaMod == 255 &&
+        _mm256_movemask_epi8(_mm256_cmpeq_epi32(
+            _mm256_and_si256(s, alphaMask), alphaMask)) == -1) {
+      _mm256_storeu_si256(out, s);
+      continue;
+    }
+    const __m256i d = _mm256_loadu_si256(out);
+    // unpack and pack both work within 128-bit halves, so the pixel order
+    // survives the round trip
+    const __m256i lo = blendWideAvx2(_mm256_unpacklo_epi8(s, zero),
+                                     _mm256_unpacklo_epi8(d, zero),
+                                     mod,
+                                     premultiplied);
+    const __m256i hi = blendWideAvx2(_mm256_unpackhi_epi8(s, zero),
+                                     _mm256_unpackhi_epi8(d, zero),
+                                     mod,
+                                     premultiplied);
+    _mm256_storeu_si256(out, _mm256_packus_epi16(lo, hi));
+  }
+  blendRowSse2(dst + i, src + i, n - i, alphaMod, premultiplied);
+}
+
+SDL2W_TARGET_AVX2 void fillRowAvx2(uint32_t* dst, int n, uint32_t color) {
+  if (color >= 0xff000000) {
+    std::fill(dst, dst + n, color);
+    return;
+  }
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i p = _mm256_unpacklo_epi8(
+      _mm256_set1_epi32(static_cast<int>(blendPixel(0, color, 255, false))),
+      zero);
+  const __m256i inv =
+      _mm256_set1_epi16(static_cast<short>(255 - (color >> 24)));
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i* out = reinterpret_cast<__m256i*>(dst + i);
+    const __m256i d = _mm256_loadu_si256(out);
+    const __m256i lo = _mm256_add_epi16(
+        p,
+        div255Avx2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), inv)));
+    const __m256i hi = _mm256_add_epi16(
+        p,
+        div255Avx2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), inv)));
+    _mm256_storeu_si256(out, _mm256_packus_epi16(lo, hi));
+  }
+  fillRowSse2(dst + i, n - i, color);
+}
+
+SDL2W_TARGET_AVX2 void gatherRowAvx2(uint32_t* out,
+                                     const uint32_t* src,
+                                     const int32_t* idx,
+                                     int n) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i minusOne = _mm256_set1_epi32(-1);
+  const int* base = reinterpret_cast<const int*>(src);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i index =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(idx + i));
+    const __m256i inside = _mm256_cmpgt_epi32(index, minusOne);
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(out + i),
+        _mm256_mask_i32gather_epi32(zero, base, index, inside, 4));
+  }
+  gatherRowScalar(out + i, src, idx + i, n - i);
+}
+#endif
+
+const Kernels SCALAR_KERNELS = {blendRowScalar, fillRowScalar, gatherRowScalar};
+#ifdef SDL2W_RASTER_X86
+const Kernels SSE2_KERNELS = {blendRowSse2, fillRowSse2, gatherRowScalar};
+const Kernels AVX2_KERNELS = {blendRowAvx2, fillRowAvx2, gatherRowAvx2};
+#endif
+
+struct ActiveKernels {
+  RasterIsa isa = RASTER_SCALAR;
+  const Kernels* kernels = &SCALAR_KERNELS;
+};
+
+const Kernels* getKernelsFor(RasterIsa isa) {
+#ifdef SDL2W_RASTER_X86
+  if (isa == RASTER_AVX2) {
+    return &AVX2_KERNELS;
+  }
+  if (isa == RASTER_SSE2) {
+    return &SSE2_KERNELS;
+  }
+#endif
+  (void)isa;
+  return &SCALAR_KERNELS;
+}
+
+ActiveKernels& getActive() {
+  static ActiveKernels active = []() {
+    ActiveKernels detected;
+    for (RasterIsa isa : {RASTER_AVX2, RASTER_SSE2}) {
+      if (SoftRaster::isIsaSupported(isa)) {
+        detected.isa = isa;
+        detected.kernels = getKernelsFor(isa);
+        break;
+      }
+    }
+    return detected;
+  }();
+  return active;
+}
+
+inline const Kernels& kernels() { return *getActive().kernels; }
+
+// Never destroyed: textures can still be released while statics are torn
+// down.
+std::unordered_map<SDL_Texture*, std::unique_ptr<RasterImage>>& getImages() {
+  static auto* images =
+      new std::unordered_map<SDL_Texture*, std::unique_ptr<RasterImage>>();
+  return *images;
+}
+
+// released images wait here until freeReleased(), see SoftRaster.h
+std::vector<std::unique_ptr<RasterImage>>& getReleased() {
+  static auto* released = new std::vector<std::unique_ptr<RasterImage>>();
+  return *released;
+}
+
+// per thread, so separate targets (or tiles of one) can be rasterized in
+// parallel
+thread_local std::vector<uint32_t> rowScratch;
+thread_local std::vector<int32_t> indexScratch;
+thread_local std::vector<int64_t> polyScratch;
+thread_local bool clipEnabled = false;
+thread_local SDL_Rect clipRect = {0, 0, 0, 0};
+
+// the pixels of target that may be drawn, x0/y0 inclusive, x1/y1 exclusive
+struct Bounds {
+  int x0 = 0;
+  int y0 = 0;
+  int x1 = 0;
+  int y1 = 0;
+};
+
+Bounds getBounds(const RasterImage& target) {
+  Bounds bounds = {0, 0, target.w, target.h};
+  if (clipEnabled) {
+    bounds.x0 = std::max(bounds.x0, clipRect.x);
+    bounds.y0 = std::max(bounds.y0, clipRect.y);
+    bounds.x1 = std::min(bounds.x1, clipRect.x + clipRect.w);
+    bounds.y1 = std::min(bounds.y1, clipRect.y + clipRect.h);
+  }
+  return bounds;
+}
+
+void plot(RasterImage& target,
+          const Bounds& bounds,
+          int x,
+          int y,
+          uint32_t color) {
+  if (x >= bounds.x0 && y >= bounds.y0 && x < bounds.x1 && y < bounds.y1) {
+    kernels().fillRow(&target.pixels[static_cast<size_t>(y) * target.w + x],
+                      1,
+                      color);
+  }
+}
+
+// x1 to x2 inclusive, in either order, like a horizontal SDL_RenderDrawLine
+void hline(RasterImage& target,
+           const Bounds& bounds,
+           int x1,
+           int x2,
+           int y,
+           uint32_t color) {
+  if (y < bounds.y0 || y >= bounds.y1) {
+    return;
+  }
+  const int x0 = std::max(bounds.x0, std::min(x1, x2));
+  const int xEnd = std::min(bounds.x1 - 1, std::max(x1, x2));
+  if (x0 > xEnd) {
+    return;
+  }
+  kernels().fillRow(&target.pixels[static_cast<size_t>(y) * target.w + x0],
+                    xEnd - x0 + 1,
+                    color);
+}
+
+void drawThinLine(
+    RasterImage& target, int x1, int y1, int x2, int y2, uint32_t color) {
+  const Bounds bounds = getBounds(target);
+  if (y1 == y2) {
+    hline(target, bounds, x1, x2, y1, color);
+    return;
+  }
+  const int dx = std::abs(x2 - x1);
+  const int dy = -std::abs(y2 - y1);
+  const int sx = x1 < x2 ? 1 : -1;
+  const int sy = y1 < y2 ? 1 : -1;
+  int err = dx + dy;
+  while (true) {
+    plot(target, bounds, x1, y1, color);
+    if (x1 == x2 && y1 == y2) {
+      break;
+    }
+    const int e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x1 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y1 += sy;
+    }
+  }
+}
+} // namespace
+
+RasterIsa SoftRaster::getIsa() { return getActive().isa; }
+
+bool SoftRaster::isIsaSupported(RasterIsa isa) {
+  switch (isa) {
+  case RASTER_SCALAR:
+    return true;
+#ifdef SDL2W_RASTER_X86
+  case RASTER_SSE2:
+    // part of x86-64
+    return true;
+  case RASTER_AVX2:
+    return SDL_HasAVX2() == SDL_TRUE;
+#endif
+  default:
+    return false;
+  }
+}
+
+bool SoftRaster::setIsa(RasterIsa isa) {
+  if (!isIsaSupported(isa)) {
+    return false;
+  }
+  ActiveKernels& active = getActive();
+  active.isa = isa;
+  active.kernels = getKernelsFor(isa);
+  return true;
+}
+
+const char* SoftRaster::getIsaName(RasterIsa isa) {
+  switch (isa) {
+  case RASTER_SSE2:
+    return "sse2";
+  case RASTER_AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+RasterImage* SoftRaster::getImage(SDL_Texture* tex) {
+  auto& images = getImages();
+  auto it = images.find(tex);
+  return it != images.end() ? it->second.get() : nullptr;
+}
+
+RasterImage& SoftRaster::createImage(SDL_Texture* tex, int w, int h) {
+  std::unique_ptr<RasterImage>& image = getImages()[tex];
+  if (image == nullptr) {
+    image = std::make_unique<RasterImage>();
+  }
+  image->w = std::max(0, w);
+  image->h = std::max(0, h);
+  image->pixels.assign(static_cast<size_t>(image->w) * image->h, 0);
+  return *image;
+}
+
+bool SoftRaster::setImage(SDL_Texture* tex, SDL_Surface* surf) {
+  if (tex == nullptr || surf == nullptr) {
+    return false;
+  }
+  SDL_Surface* converted = surf;
+  if (surf->format->format != SDL_PIXELFORMAT_ARGB8888 ||
+      SDL_HasColorKey(surf)) {
+    converted = SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_ARGB8888, 0);
+    if (converted == nullptr) {
+      LOG(WARN) << "[sdl2w] Could not convert a surface for the raster "
+                   "backend: "
+                << SDL_GetError() << Logger::endl;
+      return false;
+    }
+  }
+  RasterImage& image = createImage(tex, converted->w, converted->h);
+  SDL_LockSurface(converted);
+  const auto* pixels = static_cast<const Uint8*>(converted->pixels);
+  for (int y = 0; y < image.h; y++) {
+    std::memcpy(&image.pixels[static_cast<size_t>(y) * image.w],
+                pixels + static_cast<size_t>(y) * converted->pitch,
+                static_cast<size_t>(image.w) * sizeof(uint32_t));
+  }
+  SDL_UnlockSurface(converted);
+  if (converted != surf) {
+    SDL_FreeSurface(converted);
+  }
+  return true;
+}
+
+void SoftRaster::releaseImage(SDL_Texture* tex) {
+  auto& images = getImages();
+  if (images.empty()) {
+    return;
+  }
+  auto it = images.find(tex);
+  if (it != images.end()) {
+    getReleased().push_back(std::move(it->second));
+    images.erase(it);
+  }
+}
+
+void SoftRaster::freeReleased() { getReleased().clear(); }
+
+void SoftRaster::releaseAll() {
+  getImages().clear();
+  freeReleased();
+}
+
+void SoftRaster::setClipRect(const SDL_Rect* rect) {
+  clipEnabled = rect != nullptr;
+  if (rect != nullptr) {
+    clipRect = *rect;
+  }
+}
+
+void SoftRaster::clear(RasterImage& target, const SDL_Color& color) {
+  const uint32_t pixel = toPixel(color);
+  if (!clipEnabled) {
+    std::fill(target.pixels.begin(), target.pixels.end(), pixel);
+    return;
+  }
+  const Bounds bounds = getBounds(target);
+  for (int y = bounds.y0; y < bounds.y1; y++) {
+    std::fill_n(&target.pixels[static_cast<size_t>(y) * target.w + bounds.x0],
+                bounds.x1 - bounds.x0,
+                pixel);
+  }
+}
+
+void SoftRaster::drawQuad(RasterImage& target,
+                          const RasterImage& src,
+                          const RasterQuad& quad) {
+  const SDL_Rect& dst = quad.dst;
+  // like SDL, clip the source rect to the image and stretch what is left
+  const int clipX0 = std::max(quad.clip.x, 0);
+  const int clipY0 = std::max(quad.clip.y, 0);
+  const int clipX1 = std::min(quad.clip.x + quad.clip.w, src.w);
+  const int clipY1 = std::min(quad.clip.y + quad.clip.h, src.h);
+  if (dst.w <= 0 || dst.h <= 0 || clipX1 <= clipX0 || clipY1 <= clipY0 ||
+      quad.alphaMod <= 0) {
+    return;
+  }
+  const SDL_Rect clip = {clipX0, clipY0, clipX1 - clipX0, clipY1 - clipY0};
+  const uint32_t alphaMod =
+      static_cast<uint32_t>(std::min(255, quad.alphaMod));
+  const Kernels& k = kernels();
+  const Bounds bounds = getBounds(target);
+
+  if (quad.angleDeg == 0.) {
+    const int x0 = std::max(dst.x, bounds.x0);
+    const int y0 = std::max(dst.y, bounds.y0);
+    const int x1 = std::min(dst.x + dst.w, bounds.x1);
+    const int y1 = std::min(dst.y + dst.h, bounds.y1);
+    if (x1 <= x0 || y1 <= y0) {
+      return;
+    }
+    const int n = x1 - x0;
+    if (dst.w == clip.w && dst.h == clip.h && !quad.flipped) {
+      for (int y = y0; y < y1; y++) {
+        const uint32_t* srcRow =
+            &src.pixels[static_cast<size_t>(clip.y + y - dst.y) * src.w +
+                        clip.x + x0 - dst.x];
+        k.blendRow(&target.pixels[static_cast<size_t>(y) * target.w + x0],
+                   srcRow,
+                   n,
+                   alphaMod,
+                   quad.premultiplied);
+      }
+      return;
+    }
+
+    // nearest sampling at pixel centers; the columns are the same every row
+    indexScratch.resize(n);
+    rowScratch.resize(n);
+    const int64_t dstW2 = 2 * static_cast<int64_t>(dst.w);
+    const int64_t dstH2 = 2 * static_cast<int64_t>(dst.h);
+    for (int i = 0; i < n; i++) {
+      const int64_t u = x0 + i - dst.x;
+      int sx = static_cast<int>((2 * u + 1) * clip.w / dstW2);
+      if (quad.flipped) {
+        sx = clip.w - 1 - sx;
+      }
+      indexScratch[i] = clip.x + sx;
+    }
+    for (int y = y0; y < y1; y++) {
+      const int64_t v = y - dst.y;
+      const int sy = clip.y + static_cast<int>((2 * v + 1) * clip.h / dstH2);
+      k.gatherRow(rowScratch.data(),
+                  &src.pixels[static_cast<size_t>(sy) * src.w],
+                  indexScratch.data(),
+                  n);
+      k.blendRow(&target.pixels[static_cast<size_t>(y) * target.w + x0],
+                 rowScratch.data(),
+                 n,
+                 alphaMod,
+                 quad.premultiplied);
+    }
+    return;
+  }
+
+  // rotated: map every pixel center in the bounding box back into dst
+  const double rad = quad.angleDeg * PI / 180.;
+  const double c = std::cos(rad);
+  const double s = std::sin(rad);
+  const double halfW = dst.w / 2.;
+  const double halfH = dst.h / 2.;
+  const double centerX = dst.x + halfW;
+  const double centerY = dst.y + halfH;
+  const double extentX = halfW * std::abs(c) + halfH * std::abs(s);
+  const double extentY = halfW * std::abs(s) + halfH * std::abs(c);
+  const int x0 =
+      std::max(bounds.x0, static_cast<int>(std::floor(centerX - extentX)));
+  const int y0 =
+      std::max(bounds.y0, static_cast<int>(std::floor(centerY - extentY)));
+  const int x1 =
+      std::min(bounds.x1, static_cast<int>(std::ceil(centerX + extentX)));
+  const int y1 =
+      std::min(bounds.y1, static_cast<int>(std::ceil(centerY + extentY)));
+  if (x1 <= x0 || y1 <= y0) {
+    return;
+  }
+  const int n = x1 - x0;
+  indexScratch.resize(n);
+  rowScratch.resize(n);
+  const double scaleU = static_cast<double>(clip.w) / dst.w;
+  const double scaleV = static_cast<double>(clip.h) / dst.h;
+  for (int y = y0; y < y1; y++) {
+    const double dy = y + 0.5 - centerY;
+    const double rowU = dy * s + halfW;
+    const double rowV = dy * c + halfH;
+    int first = n;
+    int last = -1;
+    for (int i = 0; i < n; i++) {
+      // from the pixel itself rather than stepped along the row, so a pixel
+      // samples the same texel however the row is clipped
+      const double dx = x0 + i + 0.5 - centerX;
+      const double u = dx * c + rowU;
+      const double v = rowV - dx * s;
+      int32_t index = -1;
+      if (u >= 0. && v >= 0. && u < dst.w && v < dst.h) {
+        int sx = std::min(clip.w - 1, static_cast<int>(u * scaleU));
+        const int sy = std::min(clip.h - 1, static_cast<int>(v * scaleV));
+        if (quad.flipped) {
+          sx = clip.w - 1 - sx;
+        }
+        index = (clip.y + sy) * src.w + clip.x + sx;
+        first = std::min(first, i);
+        last = i;
+      }
+      indexScratch[i] = index;
+    }
+    if (last < first) {
+      continue;
+    }
+    const int span = last - first + 1;
+    k.gatherRow(
+        rowScratch.data(), src.pixels.data(), &indexScratch[first], span);
+    k.blendRow(
+        &target.pixels[static_cast<size_t>(y) * target.w + x0 + first],
+        rowScratch.data(),
+        span,
+        alphaMod,
+        quad.premultiplied);
+  }
+}
+
+void SoftRaster::fillRect(RasterImage& target,
+                          const SDL_Rect& rect,
+                          const SDL_Color& color) {
+  // the software renderer draws nothing for empty or negative rects either
+  if (rect.w <= 0 || rect.h <= 0) {
+    return;
+  }
+  const Bounds bounds = getBounds(target);
+  const int x0 = std::max(rect.x, bounds.x0);
+  const int y0 = std::max(rect.y, bounds.y0);
+  const int x1 = std::min(rect.x + rect.w, bounds.x1);
+  const int y1 = std::min(rect.y + rect.h, bounds.y1);
+  if (x1 <= x0 || y1 <= y0) {
+    return;
+  }
+  const uint32_t pixel = toPixel(color);
+  const Kernels& k = kernels();
+  for (int y = y0; y < y1; y++) {
+    k.fillRow(
+        &target.pixels[static_cast<size_t>(y) * target.w + x0], x1 - x0, pixel);
+  }
+}
+
+void SoftRaster::drawPoint(RasterImage& target,
+                           int x,
+                           int y,
+                           const SDL_Color& color) {
+  plot(target, getBounds(target), x, y, toPixel(color));
+}
+
+void SoftRaster::drawLine(RasterImage& target,
+                          int x1,
+                          int y1,
+                          int x2,
+                          int y2,
+                          int width,
+                          const SDL_Color& color) {
+  if (width <= 1) {
+    drawThinLine(target, x1, y1, x2, y2, toPixel(color));
+    return;
+  }
+  // SDL2_gfx takes the width as a Uint8
+  width = std::min(width, 255);
+  if (x1 == x2 && y1 == y2) {
+    const int halfW = width / 2;
+    fillRect(target,
+             {x1 - halfW, y1 - halfW, width + halfW + 1, width + halfW + 1},
+             color);
+    return;
+  }
+  // a quad around the line, with the width adjusted for the angle
+  const double dx = x2 - x1;
+  const double dy = y2 - y1;
+  const double l = std::sqrt(dx * dx + dy * dy);
+  const double ang = std::atan2(dx, dy);
+  const double adj = 0.1 + 0.9 * std::fabs(std::cos(2. * ang));
+  const double wl2 = (width - adj) / (2. * l);
+  const double nx = dx * wl2;
+  const double ny = dy * wl2;
+  const Sint16 px[4] = {static_cast<Sint16>(x1 + ny),
+                        static_cast<Sint16>(x1 - ny),
+                        static_cast<Sint16>(x2 - ny),
+                        static_cast<Sint16>(x2 + ny)};
+  const Sint16 py[4] = {static_cast<Sint16>(y1 - nx),
+                        static_cast<Sint16>(y1 + nx),
+                        static_cast<Sint16>(y2 + nx),
+                        static_cast<Sint16>(y2 - nx)};
+  fillPolygon(target, px, py, 4, color);
+}
+
+void SoftRaster::fillPolygon(RasterImage& target,
+                             const Sint16* vx,
+                             const Sint16* vy,
+                             int n,
+                             const SDL_Color& color) {
+  if (n < 3) {
+    return;
+  }
+  int minY = vy[0];
+  int maxY = vy[0];
+  for (int i = 1; i < n; i++) {
+    if (vy[i] < minY) {
+      minY = vy[i];
+    } else if (vy[i] > maxY) {
+      maxY = vy[i];
+    }
+  }
+  const uint32_t pixel = toPixel(color);
+  const Bounds bounds = getBounds(target);
+  polyScratch.resize(n);
+  // rows outside the target draw nothing, so they are skipped
+  const int yEnd = std::min(maxY, bounds.y1 - 1);
+  for (int y = std::max(minY, bounds.y0); y <= yEnd; y++) {
+    int ints = 0;
+    for (int i = 0; i < n; i++) {
+      const int ind1 = i == 0 ? n - 1 : i - 1;
+      const int ind2 = i == 0 ? 0 : i;
+      int y1 = vy[ind1];
+      int y2 = vy[ind2];
+      int x1 = 0;
+      int x2 = 0;
+      if (y1 < y2) {
+        x1 = vx[ind1];
+        x2 = vx[ind2];
+      } else if (y1 > y2) {
+        y2 = vy[ind1];
+        y1 = vy[ind2];
+        x2 = vx[ind1];
+        x1 = vx[ind2];
+      } else {
+        continue;
+      }
+      if ((y >= y1 && y < y2) || (y == maxY && y > y1 && y <= y2)) {
+        // 16.16 fixed point crossing
+        polyScratch[ints++] =
+            int64_t{65536} * (y - y1) / (y2 - y1) * (x2 - x1) +
+            int64_t{65536} * x1;
+      }
+    }
+    std::sort(polyScratch.begin(), polyScratch.begin() + ints);
+    for (int i = 0; i + 1 < ints; i += 2) {
+      int64_t xa = polyScratch[i] + 1;
+      xa = (xa >> 16) + ((xa & 32768) >> 15);
+      int64_t xb = polyScratch[i + 1] - 1;
+      xb = (xb >> 16) + ((xb & 32768) >> 15);
+      hline(target,
+            bounds,
+            static_cast<int>(xa),
+            static_cast<int>(xb),
+            y,
+            pixel);
+    }
+  }
+}
+
+void SoftRaster::drawCircle(RasterImage& target,
+                            int x,
+                            int y,
+                            int radius,
+                            const SDL_Color& color,
+                            bool filled) {
+  const uint32_t pixel = toPixel(color);
+  const Bounds bounds = getBounds(target);
+  int offsetX = 0;
+  int offsetY = radius;
+  int d = radius - 1;
+  while (offsetY >= offsetX) {
+    if (filled) {
+      hline(target, bounds, x - offsetY, x + offsetY, y + offsetX, pixel);
+      hline(target, bounds, x - offsetX, x + offsetX, y + offsetY, pixel);
+      hline(target, bounds, x - offsetX, x + offsetX, y - offsetY, pixel);
+      hline(target, bounds, x - offsetY, x + offsetY, y - offsetX, pixel);
+    } else {
+      plot(target, bounds, x + offsetX, y + offsetY, pixel);
+      plot(target, bounds, x + offsetY, y + offsetX, pixel);
+      plot(target, bounds, x - offsetX, y + offsetY, pixel);
+      plot(target, bounds, x - offsetY, y + offsetX, pixel);
+      plot(target, bounds, x + offsetX, y - offsetY, pixel);
+      plot(target, bounds, x + offsetY, y - offsetX, pixel);
+      plot(target, bounds, x - offsetX, y - offsetY, pixel);
+      plot(target, bounds, x - offsetY, y - offsetX, pixel);
+    }
+
+    if (d >= 2 * offsetX) {
+      d -= 2 * offsetX + 1;
+      offsetX += 1;
+    } else if (d < 2 * (radius - offsetY)) {
+      d += 2 * offsetY - 1;
+      offsetY -= 1;
+    } else {
+      d += 2 * (offsetY - offsetX - 1);
+      offsetY -= 1;
+      offsetX += 1;
+    }
+  }
+}
+
+} // namespace sdl2w
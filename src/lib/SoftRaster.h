@@ -0,0 +1,121 @@
+// SoftRaster is the CPU rasterizer behind Draw's raster backend (see
+// Draw::setRasterBackend).  It draws into ARGB8888 images in system memory:
+// textured quads (straight, scaled with nearest sampling, rotated, flipped),
+// filled rects and polygons, lines and circles.  Blending is SDL's
+// SDL_BLENDMODE_BLEND, or src + dst * (1 - srcA) for premultiplied textures,
+// with every product rounded to the nearest 1/255.
+//
+// Per-pixel work runs in kernels picked at startup: AVX2 when the CPU has it,
+// SSE2 on other x86-64 CPUs and plain C++ everywhere else.  All of them
+// compute the same pixels, so the choice only changes speed; setIsa() forces
+// one for benchmarks.
+//
+// Images are kept per SDL_Texture so Draw can go on passing textures around.
+// SDL_Deleter releases a texture's image when it destroys the texture; the
+// pixels stay valid until freeReleased(), because Draw may still have draws
+// of the texture recorded for a tiled frame.
+//
+// Drawing functions may run on several threads at once as long as they don't
+// write the same pixels, e.g. one thread per tile of a frame, each limited to
+// its tile with setClipRect().  Image lookups and releases are main thread
+// only.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#if __has_include(<SDL_rect.h>)
+#include <SDL_rect.h>
+#else
+#include <SDL2/SDL_rect.h>
+#endif
+
+struct SDL_Texture;
+struct SDL_Surface;
+
+namespace sdl2w {
+
+enum RasterIsa {
+  RASTER_SCALAR,
+  RASTER_SSE2,
+  RASTER_AVX2,
+};
+
+struct RasterImage {
+  int w = 0;
+  int h = 0;
+  // ARGB8888, w * h without row padding
+  std::vector<uint32_t> pixels;
+};
+
+// A textured quad with the meaning SDL_RenderCopyEx gives its arguments: clip
+// is flipped horizontally if requested, stretched to dst and rotated
+// clockwise by angleDeg around the center of dst.
+struct RasterQuad {
+  SDL_Rect clip = {0, 0, 0, 0};
+  SDL_Rect dst = {0, 0, 0, 0};
+  double angleDeg = 0.;
+  // multiplies the source alpha, and the source colors when premultiplied
+  int alphaMod = 255;
+  bool flipped = false;
+  bool premultiplied = false;
+};
+
+class SoftRaster {
+public:
+  static RasterIsa getIsa();
+  static bool isIsaSupported(RasterIsa isa);
+  // Returns false, changing nothing, when the CPU can't run isa.
+  static bool setIsa(RasterIsa isa);
+  static const char* getIsaName(RasterIsa isa);
+
+  static RasterImage* getImage(SDL_Texture* tex);
+  // a transparent w x h image for tex, replacing the previous one
+  static RasterImage& createImage(SDL_Texture* tex, int w, int h);
+  // Copies the pixels of surf (converted to ARGB8888, with a color key
+  // turned into alpha) as the image of tex.
+  static bool setImage(SDL_Texture* tex, SDL_Surface* surf);
+  static void releaseImage(SDL_Texture* tex);
+  static void freeReleased();
+  static void releaseAll();
+
+  // Limits drawing on the calling thread to rect, like SDL_RenderSetClipRect,
+  // or lifts the limit when rect is nullptr.  Pixels are the same as without
+  // a clip rect inside it.
+  static void setClipRect(const SDL_Rect* rect);
+
+  // fills every pixel inside the clip rect with color, no blending
+  static void clear(RasterImage& target, const SDL_Color& color);
+  static void drawQuad(RasterImage& target,
+                       const RasterImage& src,
+                       const RasterQuad& quad);
+  static void
+  fillRect(RasterImage& target, const SDL_Rect& rect, const SDL_Color& color);
+  static void
+  drawPoint(RasterImage& target, int x, int y, const SDL_Color& color);
+  // Width 1 draws what SDL_RenderDrawLine does, wider lines follow SDL2_gfx's
+  // thickLineRGBA.  Both end points are drawn.
+  static void drawLine(RasterImage& target,
+                       int x1,
+                       int y1,
+                       int x2,
+                       int y2,
+                       int width,
+                       const SDL_Color& color);
+  // the scanline fill of SDL2_gfx's filledPolygonRGBA
+  static void fillPolygon(RasterImage& target,
+                          const Sint16* vx,
+                          const Sint16* vy,
+                          int n,
+                          const SDL_Color& color);
+  // the midpoint circles Draw draws with SDL
+  static void drawCircle(RasterImage& target,
+                         int x,
+                         int y,
+                         int radius,
+                         const SDL_Color& color,
+                         bool filled);
+};
+
+} // namespace sdl2w
@@ -3,6 +3,9 @@
 #include "Defines.h"
 #include "Draw.h"
 #include "Logger.h"
+#include "Profiler.h"
+#include "SoftRaster.h"
+#include "Subsystems.h"
 #include <algorithm>
 #include <string_view>
 
@@ -35,6 +38,7 @@ void SDL_Deleter::operator()(SDL_Renderer* p) const {
 }
 void SDL_Deleter::operator()(SDL_Texture* p) const {
   if (p != nullptr) {
+    SoftRaster::releaseImage(p);
     SDL_DestroyTexture(p);
   }
 }
@@ -106,6 +110,8 @@ AnimationDefinition& Store::storeAnimationDefinition(std::string_view name,
 }
 
 void Store::loadAndStoreFont(std::string_view name, std::string_view path) {
+  SDL2W_ZONE("Store::loadAndStoreFont");
+  Subsystems::ensureTtf();
   const std::string pathStr(path);
   static const std::vector<int> sizes = {TEXT_SIZE_10,
                                          TEXT_SIZE_12,
@@ -153,6 +159,8 @@ void Store::createFontAlias(std::string_view aliasName,
 }
 
 void Store::storeSound(std::string_view name, std::string_view path) {
+  SDL2W_ZONE("Store::storeSound");
+  Subsystems::ensureAudio();
   const std::string nameStr(name);
   const std::string pathStr(path);
   if (sounds.find(nameStr) != sounds.end()) {
@@ -170,6 +178,8 @@ void Store::storeSound(std::string_view name, std::string_view path) {
 }
 
 void Store::storeMusic(std::string_view name, std::string_view path) {
+  SDL2W_ZONE("Store::storeMusic");
+  Subsystems::ensureAudio();
   const std::string nameStr(name);
   const std::string pathStr(path);
   if (musics.find(nameStr) != musics.end()) {
@@ -288,11 +298,60 @@ Animation Store::createAnimation(std::string_view name, bool flipped) {
   return anim;
 }
 
+bool Store::hasTexture(std::string_view name) {
+  const std::string nameStr(name);
+  return textures.find(nameStr) != textures.end();
+}
+
 bool Store::hasDynamicTexture(std::string_view name) {
   const std::string nameStr(name);
   return dynamicTextures.find(nameStr) != dynamicTextures.end();
 }
 
+bool Store::hasSprite(std::string_view name) {
+  const std::string nameStr(name);
+  return sprites.find(nameStr) != sprites.end();
+}
+
+void Store::removeTexture(std::string_view name) {
+  textures.erase(std::string(name));
+}
+
+void Store::removeSprite(std::string_view name) {
+  sprites.erase(std::string(name));
+}
+
+static size_t getTextureBytes(SDL_Texture* tex) {
+  Uint32 format = 0;
+  int w = 0;
+  int h = 0;
+  SDL_QueryTexture(tex, &format, nullptr, &w, &h);
+  const size_t bytesPerPixel =
+      format == SDL_PIXELFORMAT_UNKNOWN ? 4 : SDL_BYTESPERPIXEL(format);
+  return static_cast<size_t>(w) * static_cast<size_t>(h) * bytesPerPixel;
+}
+
+StoreMemoryUsage Store::getMemoryUsage() const {
+  StoreMemoryUsage usage;
+  for (const auto& pair : textures) {
+    usage.textureBytes += getTextureBytes(pair.second.get());
+  }
+  for (const auto& pair : dynamicTextures) {
+    usage.dynamicTextureBytes += getTextureBytes(pair.second.get());
+  }
+  for (const auto& pair : sounds) {
+    if (pair.second) {
+      usage.soundBytes += pair.second->alen;
+    }
+  }
+  return usage;
+}
+
+size_t Store::getResidentAssetCount() const {
+  return textures.size() + dynamicTextures.size() + sprites.size() +
+         anims.size() + fonts.size() + sounds.size() + musics.size();
+}
+
 void Store::logAllSprites() {
   std::vector<std::string> keys;
   for (const auto& pair : sprites) {
@@ -11,6 +11,15 @@
 
 namespace sdl2w {
 
+struct StoreMemoryUsage {
+  size_t textureBytes = 0;
+  size_t dynamicTextureBytes = 0;
+  size_t soundBytes = 0;
+  size_t getTotalBytes() const {
+    return textureBytes + dynamicTextureBytes + soundBytes;
+  }
+};
+
 class Store {
 public:
   std::unordered_map<std::string, std::unique_ptr<SDL_Texture, SDL_Deleter>>
@@ -52,7 +61,20 @@ public:
   Mix_Music* getMusic(std::string_view name);
   Animation createAnimation(std::string_view name, bool flipped = false);
 
+  bool hasTexture(std::string_view name);
   bool hasDynamicTexture(std::string_view name);
+  bool hasSprite(std::string_view name);
+
+  // Frees a texture or sprite before clear().  Sprites and Animations created
+  // from them keep dangling pointers, so only remove assets nothing still
+  // draws.
+  void removeTexture(std::string_view name);
+  void removeSprite(std::string_view name);
+
+  // Estimated from texture dimensions and decoded sound sizes; fonts and music
+  // streams are not included.
+  StoreMemoryUsage getMemoryUsage() const;
+  size_t getResidentAssetCount() const;
 
   void logAllSprites();
   void logAllAnimationDefinitions();
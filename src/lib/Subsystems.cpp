@@ -0,0 +1,81 @@
+#include "Subsystems.h"
+#include "Defines.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include <stdexcept>
+#include <string>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#include <SDL_mixer.h>
+#include <SDL_ttf.h>
+#else
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+#include <SDL2/SDL_ttf.h>
+#endif
+
+namespace sdl2w {
+
+Subsystems::State Subsystems::ttfState = Subsystems::NOT_INIT;
+Subsystems::State Subsystems::audioState = Subsystems::NOT_INIT;
+int Subsystems::numSoundChannels = 0;
+
+void Subsystems::ensureTtf() {
+  if (ttfState == READY) {
+    return;
+  }
+  SDL2W_ZONE("TTF_Init");
+  if (TTF_Init() < 0) {
+    ttfState = FAILED;
+    LOG_LINE(ERROR) << "[sdl2w] SDL_ttf could not initialize! "
+                    << std::string(TTF_GetError()) << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  ttfState = READY;
+}
+
+bool Subsystems::ensureAudio() {
+  if (audioState != NOT_INIT) {
+    return audioState == READY;
+  }
+  SDL2W_ZONE("Mix_OpenAudio");
+  if (!SDL_WasInit(SDL_INIT_AUDIO) && SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+    LOG_LINE(ERROR) << "[sdl2w] SDL audio could not initialize! "
+                    << SDL_GetError() << Logger::endl;
+    audioState = FAILED;
+    return false;
+  }
+  if (Mix_OpenAudio(MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, 1, 1024) < 0) {
+    LOG_LINE(ERROR) << "[sdl2w] SDL_mixer could not initialize! "
+                    << std::string(Mix_GetError()) << Logger::endl;
+    audioState = FAILED;
+    return false;
+  }
+  audioState = READY;
+  if (numSoundChannels > 0) {
+    Mix_AllocateChannels(numSoundChannels);
+  }
+  return true;
+}
+
+void Subsystems::setNumSoundChannels(int n) {
+  numSoundChannels = n;
+  if (audioState == READY) {
+    Mix_AllocateChannels(numSoundChannels);
+  }
+}
+
+void Subsystems::quit() {
+  if (ttfState == READY) {
+    TTF_Quit();
+  }
+  if (audioState == READY) {
+    Mix_CloseAudio();
+  }
+  Mix_Quit();
+  ttfState = NOT_INIT;
+  audioState = NOT_INIT;
+}
+
+} // namespace sdl2w
@@ -0,0 +1,31 @@
+// Subsystems opens and closes SDL_ttf and SDL_mixer.  Window::init opens both
+// up front unless WindowInitParams asks for them to be lazy, in which case the
+// first Store load or Window playback call that needs one opens it.  Deferring
+// audio keeps device setup off the path to the first frame (and, in browsers,
+// until the page has had a user gesture).
+
+#pragma once
+
+namespace sdl2w {
+
+class Subsystems {
+  enum State { NOT_INIT, READY, FAILED };
+
+  static State ttfState;
+  static State audioState;
+  static int numSoundChannels;
+
+public:
+  // Opens SDL_ttf if needed.  Throws if it can't be initialized.
+  static void ensureTtf();
+  // Opens the audio device and SDL_mixer if needed.  Returns false (once per
+  // failure, logged) when audio is unavailable.
+  static bool ensureAudio();
+  static bool isTtfReady() { return ttfState == READY; }
+  static bool isAudioReady() { return audioState == READY; }
+  // applied now if audio is open, otherwise when it opens
+  static void setNumSoundChannels(int n);
+  static void quit();
+};
+
+} // namespace sdl2w
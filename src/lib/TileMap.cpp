@@ -0,0 +1,345 @@
+#include "TileMap.h"
+#include "Draw.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "Store.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+namespace sdl2w {
+
+TileMap::TileMap(Draw& drawA, Store& storeA, const TileMapParams& paramsA)
+    : draw(drawA), store(storeA), params(paramsA) {
+  if (params.widthTiles <= 0 || params.heightTiles <= 0 ||
+      params.tileWidth <= 0 || params.tileHeight <= 0 ||
+      params.numLayers <= 0 || params.chunkTiles <= 0) {
+    LOG_LINE(ERROR) << "[sdl2w] Invalid TileMap size: " << params.widthTiles
+                    << "x" << params.heightTiles << " tiles of "
+                    << params.tileWidth << "x" << params.tileHeight
+                    << ", layers=" << params.numLayers
+                    << ", chunkTiles=" << params.chunkTiles << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  chunksX = (params.widthTiles + params.chunkTiles - 1) / params.chunkTiles;
+  chunksY = (params.heightTiles + params.chunkTiles - 1) / params.chunkTiles;
+  layers.resize(params.numLayers);
+  for (Layer& layer : layers) {
+    layer.tiles.assign(
+        static_cast<size_t>(params.widthTiles) * params.heightTiles,
+        EMPTY_TILE);
+    layer.chunks.resize(static_cast<size_t>(chunksX) * chunksY);
+  }
+}
+
+TileMap::~TileMap() {}
+
+TileMap::TileId TileMap::getSpriteTileId(std::string_view spriteName) {
+  const std::string nameStr(spriteName);
+  auto it = tileSpriteIds.find(nameStr);
+  if (it != tileSpriteIds.end()) {
+    return it->second;
+  }
+  tileSprites.push_back(&store.getSprite(nameStr));
+  const TileId id = static_cast<TileId>(tileSprites.size());
+  tileSpriteIds[nameStr] = id;
+  return id;
+}
+
+TileMap::TileId TileMap::getAnimationTileId(std::string_view animName) {
+  const std::string nameStr(animName);
+  auto it = tileAnimIds.find(nameStr);
+  if (it != tileAnimIds.end()) {
+    return it->second;
+  }
+  tileAnims.push_back(store.createAnimation(nameStr));
+  tileAnims.back().start();
+  const TileId id = -static_cast<TileId>(tileAnims.size());
+  tileAnimIds[nameStr] = id;
+  return id;
+}
+
+void TileMap::refreshSprites() {
+  for (const auto& [name, id] : tileSpriteIds) {
+    tileSprites[id - 1] =
+        store.hasSprite(name) ? &store.getSprite(name) : nullptr;
+  }
+}
+
+void TileMap::checkTile(int layer, int x, int y) const {
+  if (layer < 0 || layer >= params.numLayers || x < 0 ||
+      x >= params.widthTiles || y < 0 || y >= params.heightTiles) {
+    LOG_LINE(ERROR) << "[sdl2w] Tile out of range: layer=" << layer
+                    << " x=" << x << " y=" << y << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+}
+
+int TileMap::getChunkIndex(int x, int y) const {
+  return (y / params.chunkTiles) * chunksX + x / params.chunkTiles;
+}
+
+void TileMap::setTile(int layer, int x, int y, TileId id) {
+  checkTile(layer, x, y);
+  if (id > static_cast<TileId>(tileSprites.size()) ||
+      -id > static_cast<TileId>(tileAnims.size())) {
+    LOG_LINE(ERROR) << "[sdl2w] Unknown tile id: " << id << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+
+  Layer& l = layers[layer];
+  const int tileIndex = y * params.widthTiles + x;
+  const TileId prev = l.tiles[tileIndex];
+  if (prev == id) {
+    return;
+  }
+  l.tiles[tileIndex] = id;
+
+  Chunk& chunk = l.chunks[getChunkIndex(x, y)];
+  if (prev > 0) {
+    chunk.numStaticTiles--;
+    chunk.dirty = true;
+  } else if (prev < 0) {
+    auto& anim = chunk.animatedTiles;
+    anim.erase(std::find(anim.begin(), anim.end(), tileIndex));
+  }
+  if (id > 0) {
+    chunk.numStaticTiles++;
+    chunk.dirty = true;
+  } else if (id < 0) {
+    chunk.animatedTiles.push_back(tileIndex);
+  }
+
+  if (chunk.numStaticTiles == 0 && chunk.tex) {
+    chunk.tex.reset();
+    numCachedChunks--;
+  }
+}
+
+TileMap::TileId TileMap::getTile(int layer, int x, int y) const {
+  checkTile(layer, x, y);
+  return layers[layer].tiles[y * params.widthTiles + x];
+}
+
+void TileMap::clearLayer(int layer) {
+  checkTile(layer, 0, 0);
+  Layer& l = layers[layer];
+  std::fill(l.tiles.begin(), l.tiles.end(), EMPTY_TILE);
+  for (Chunk& chunk : l.chunks) {
+    if (chunk.tex) {
+      numCachedChunks--;
+    }
+    chunk = Chunk();
+  }
+}
+
+void TileMap::setLayerVisible(int layer, bool visible) {
+  checkTile(layer, 0, 0);
+  layers[layer].visible = visible;
+}
+
+void TileMap::invalidate() {
+  for (Layer& l : layers) {
+    for (Chunk& chunk : l.chunks) {
+      chunk.dirty = true;
+    }
+  }
+}
+
+void TileMap::update(int dt) {
+  for (Animation& anim : tileAnims) {
+    anim.update(dt);
+  }
+}
+
+// Releases the texture of the chunk drawn longest ago.  Chunks drawn this
+// frame are kept, so the cache can grow past maxCachedChunks when more chunks
+// than that are on screen at once.
+void TileMap::evictChunk() {
+  Chunk* oldest = nullptr;
+  for (Layer& l : layers) {
+    for (Chunk& chunk : l.chunks) {
+      if (chunk.tex && chunk.lastDrawnFrame < frame &&
+          (oldest == nullptr ||
+           chunk.lastDrawnFrame < oldest->lastDrawnFrame)) {
+        oldest = &chunk;
+      }
+    }
+  }
+  if (oldest != nullptr) {
+    oldest->tex.reset();
+    oldest->dirty = true;
+    numCachedChunks--;
+  }
+}
+
+void TileMap::allocateChunkTexture(Chunk& chunk, int chunkIndex) {
+  if (numCachedChunks >= params.maxCachedChunks) {
+    evictChunk();
+  }
+  const int cx = chunkIndex % chunksX;
+  const int cy = chunkIndex / chunksX;
+  const int w =
+      std::min(params.chunkTiles, params.widthTiles - cx * params.chunkTiles) *
+      params.tileWidth;
+  const int h =
+      std::min(params.chunkTiles, params.heightTiles - cy * params.chunkTiles) *
+      params.tileHeight;
+  SDL_Texture* tex = SDL_CreateTexture(draw.getSdlRenderer(),
+                                       SDL_PIXELFORMAT_RGBA32,
+                                       SDL_TEXTUREACCESS_TARGET,
+                                       w,
+                                       h);
+  if (tex == nullptr) {
+    LOG_LINE(ERROR) << "[sdl2w] Could not create tile chunk texture: "
+                    << SDL_GetError() << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+  chunk.tex.reset(tex);
+  chunk.dirty = true;
+  numCachedChunks++;
+}
+
+void TileMap::renderChunk(int layer, int chunkIndex) {
+  SDL2W_ZONE("TileMap::renderChunk");
+  Layer& l = layers[layer];
+  Chunk& chunk = l.chunks[chunkIndex];
+  if (!chunk.tex) {
+    allocateChunkTexture(chunk, chunkIndex);
+  }
+
+  const int x0 = (chunkIndex % chunksX) * params.chunkTiles;
+  const int y0 = (chunkIndex / chunksX) * params.chunkTiles;
+  const int x1 = std::min(x0 + params.chunkTiles, params.widthTiles);
+  const int y1 = std::min(y0 + params.chunkTiles, params.heightTiles);
+
+  draw.pushRenderTarget(chunk.tex.get(),
+                        (x1 - x0) * params.tileWidth,
+                        (y1 - y0) * params.tileHeight,
+                        true);
+  for (int y = y0; y < y1; y++) {
+    const TileId* row = &l.tiles[y * params.widthTiles];
+    for (int x = x0; x < x1; x++) {
+      const TileId id = row[x];
+      if (id > 0 && tileSprites[id - 1] != nullptr) {
+        draw.drawSprite(*tileSprites[id - 1],
+                        RenderableParams{.scale = {1., 1.},
+                                         .x = (x - x0) * params.tileWidth,
+                                         .y = (y - y0) * params.tileHeight,
+                                         .centered = false});
+      }
+    }
+  }
+  draw.popRenderTarget();
+  chunk.dirty = false;
+}
+
+void TileMap::render() {
+  SDL2W_ZONE("TileMap::render");
+  frame++;
+  stats = TileMapStats();
+
+  // world space bounds of the render target under the current camera
+  const auto [renderW, renderH] = draw.getRenderSize();
+  double minX = std::numeric_limits<double>::max();
+  double minY = std::numeric_limits<double>::max();
+  double maxX = std::numeric_limits<double>::lowest();
+  double maxY = std::numeric_limits<double>::lowest();
+  const double cornersX[4] = {0., 1., 0., 1.};
+  const double cornersY[4] = {0., 0., 1., 1.};
+  for (int i = 0; i < 4; i++) {
+    const auto [wx, wy] =
+        draw.screenToWorld(cornersX[i] * renderW, cornersY[i] * renderH);
+    minX = std::min(minX, wx);
+    minY = std::min(minY, wy);
+    maxX = std::max(maxX, wx);
+    maxY = std::max(maxY, wy);
+  }
+
+  const int chunkW = params.chunkTiles * params.tileWidth;
+  const int chunkH = params.chunkTiles * params.tileHeight;
+  const auto [mapW, mapH] = getSizePx();
+  if (maxX < 0. || maxY < 0. || minX >= mapW || minY >= mapH) {
+    stats.cachedChunks = numCachedChunks;
+    return;
+  }
+  const int cx0 = std::max(0, static_cast<int>(std::floor(minX / chunkW)));
+  const int cy0 = std::max(0, static_cast<int>(std::floor(minY / chunkH)));
+  const int cx1 =
+      std::min(chunksX - 1, static_cast<int>(std::floor(maxX / chunkW)));
+  const int cy1 =
+      std::min(chunksY - 1, static_cast<int>(std::floor(maxY / chunkH)));
+
+  for (int layer = 0; layer < params.numLayers; layer++) {
+    Layer& l = layers[layer];
+    if (!l.visible) {
+      continue;
+    }
+    for (int cy = cy0; cy <= cy1; cy++) {
+      for (int cx = cx0; cx <= cx1; cx++) {
+        const int chunkIndex = cy * chunksX + cx;
+        Chunk& chunk = l.chunks[chunkIndex];
+        if (chunk.numStaticTiles == 0 && chunk.animatedTiles.empty()) {
+          continue;
+        }
+        const int x = cx * chunkW;
+        const int y = cy * chunkH;
+        const int w = std::min(chunkW, mapW - x);
+        const int h = std::min(chunkH, mapH - y);
+        // rotated cameras reach this with chunks in the corners of the
+        // bounds that are still off screen
+        if (!draw.isRectVisible(x, y, w, h)) {
+          continue;
+        }
+        stats.visibleChunks++;
+
+        if (chunk.numStaticTiles > 0) {
+          chunk.lastDrawnFrame = frame;
+          if (!chunk.tex || chunk.dirty) {
+            renderChunk(layer, chunkIndex);
+            stats.renderedChunks++;
+          }
+          // baked with blending onto transparent black, so the colors are
+          // already multiplied by alpha; plain blending would darken
+          // partly transparent tile edges a second time
+          draw.drawTexture(chunk.tex.get(),
+                           RenderableParamsEx{.scale = {1., 1.},
+                                              .angleDeg = 0.,
+                                              .x = x,
+                                              .y = y,
+                                              .w = w,
+                                              .h = h,
+                                              .clipX = 0,
+                                              .clipY = 0,
+                                              .clipW = w,
+                                              .clipH = h,
+                                              .centered = false,
+                                              .flipped = false,
+                                              .premultipliedAlpha = true});
+        }
+
+        for (const int tileIndex : chunk.animatedTiles) {
+          const TileId id = l.tiles[tileIndex];
+          draw.drawAnimation(
+              tileAnims[-id - 1],
+              RenderableParams{
+                  .scale = {1., 1.},
+                  .x = (tileIndex % params.widthTiles) * params.tileWidth,
+                  .y = (tileIndex / params.widthTiles) * params.tileHeight,
+                  .centered = false});
+          stats.animatedTiles++;
+        }
+      }
+    }
+  }
+  stats.cachedChunks = numCachedChunks;
+}
+
+} // namespace sdl2w
@@ -0,0 +1,139 @@
+// A TileMap draws large grids of Store sprites.  Each layer is split into
+// square chunks, and the static tiles of a chunk are rendered once into a
+// target texture that is then drawn with a single copy, so the cost of a frame
+// depends on how many chunks are on screen rather than on the size of the map.
+// A chunk is re-rendered only after one of its tiles changes.  Chunk textures
+// are created when a chunk first becomes visible and, past maxCachedChunks,
+// the least recently drawn ones are released.  Static tiles are clipped to
+// their chunk, so sprites larger than a tile should not be placed in a map.
+//
+// Chunks are baked with blending onto transparent black, so their colors are
+// premultiplied by alpha and they are composited with a premultiplied blend.
+// The SDL software renderer (DrawMode::CPU) has no custom blend modes and
+// falls back to plain blending, which darkens partly transparent tile edges
+// a second time.  Opaque tiles are unaffected, and the raster backend
+// (Window2Params::rasterBackend) blends them correctly.
+//
+// Animated tiles are not baked into chunks.  Every animated tile of the same
+// kind shares one Animation, advanced by update(dt), and is drawn on top of
+// its chunk.
+//
+// The map covers world space from (0, 0) to (widthTiles * tileWidth,
+// heightTiles * tileHeight) and render() draws it through the Draw camera.
+// Like Animation, it keeps pointers to Sprites owned by the Store it was
+// created from, so it must not outlive a Store::clear().
+
+#pragma once
+
+#include "Animation.h"
+#include "Defines.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace sdl2w {
+class Draw;
+class Store;
+struct Sprite;
+
+struct TileMapParams {
+  int widthTiles = 0;
+  int heightTiles = 0;
+  int tileWidth = 16;
+  int tileHeight = 16;
+  int numLayers = 1;
+  // chunks are chunkTiles x chunkTiles tiles
+  int chunkTiles = 16;
+  int maxCachedChunks = 256;
+};
+
+// Work done by the last render().
+struct TileMapStats {
+  int visibleChunks = 0;
+  int renderedChunks = 0;
+  int animatedTiles = 0;
+  int cachedChunks = 0;
+};
+
+class TileMap {
+public:
+  // Positive ids are static sprites, negative ids are animations.
+  using TileId = int;
+  static constexpr TileId EMPTY_TILE = 0;
+
+private:
+  struct Chunk {
+    std::unique_ptr<SDL_Texture, SDL_Deleter> tex;
+    // tile indices (within the layer) of the animated tiles in this chunk
+    std::vector<int> animatedTiles;
+    int numStaticTiles = 0;
+    uint64_t lastDrawnFrame = 0;
+    bool dirty = true;
+  };
+
+  struct Layer {
+    std::vector<TileId> tiles;
+    std::vector<Chunk> chunks;
+    bool visible = true;
+  };
+
+  Draw& draw;
+  Store& store;
+  TileMapParams params;
+  int chunksX = 0;
+  int chunksY = 0;
+  std::vector<Layer> layers;
+
+  // nullptr where the sprite has been removed from the Store
+  std::vector<const Sprite*> tileSprites;
+  std::unordered_map<std::string, TileId> tileSpriteIds;
+  std::vector<Animation> tileAnims;
+  std::unordered_map<std::string, TileId> tileAnimIds;
+
+  int numCachedChunks = 0;
+  uint64_t frame = 0;
+  TileMapStats stats;
+
+  void checkTile(int layer, int x, int y) const;
+  int getChunkIndex(int x, int y) const;
+  void renderChunk(int layer, int chunkIndex);
+  void allocateChunkTexture(Chunk& chunk, int chunkIndex);
+  void evictChunk();
+
+public:
+  TileMap(Draw& drawA, Store& storeA, const TileMapParams& paramsA);
+  ~TileMap();
+
+  // Ids are assigned the first time a sprite or animation name is seen.
+  TileId getSpriteTileId(std::string_view spriteName);
+  TileId getAnimationTileId(std::string_view animName);
+  // Looks the sprites of every id up in the Store again, for when sprites have
+  // been removed from and re-added to it.  Ids of missing sprites draw
+  // nothing.
+  void refreshSprites();
+
+  void setTile(int layer, int x, int y, TileId id);
+  TileId getTile(int layer, int x, int y) const;
+  void clearLayer(int layer);
+  void setLayerVisible(int layer, bool visible);
+
+  // Marks every chunk for re-rendering, for example after
+  // SDL_RENDER_TARGETS_RESET has discarded the contents of target textures.
+  void invalidate();
+
+  void update(int dt);
+  void render();
+
+  const TileMapParams& getParams() const { return params; }
+  std::pair<int, int> getSizePx() const {
+    return {params.widthTiles * params.tileWidth,
+            params.heightTiles * params.tileHeight};
+  }
+  const TileMapStats& getStats() const { return stats; }
+};
+
+} // namespace sdl2w
@@ -3,6 +3,11 @@
 #include "Defines.h"
 #include "EmscriptenHelpers.h"
 #include "Logger.h"
+#include "Profiler.h"
+#include "RendererProbe.h"
+#include "Subsystems.h"
+#include <algorithm>
+#include <cmath>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
@@ -26,38 +31,103 @@
 #endif
 
 namespace sdl2w {
+static double countsToMs(uint64_t counts) {
+  static const double msPerCount =
+      1000. / static_cast<double>(SDL_GetPerformanceFrequency());
+  return static_cast<double>(counts) * msPerCount;
+}
+
 bool Window::_soundEnabled = true;
 bool Window::_inputEnabled = true;
 bool Window::_isInit = false;
 
 Window::Window(Store& store, const Window2Params& params)
-    : store(store), draw(store) {
+    : store(store), draw(store), perfOverlay(draw, store) {
   if (!_isInit) {
     LOG(WARN) << "[sdl2w] SDL is not initialized, so Window cannot be created."
               << Logger::endl;
     return;
   }
-
-  LOG(DEBUG) << "[sdl2w] Create window:"
-             << " " << params.w << " " << params.h << Logger::endl;
-
-  // create window and renderer
-  sdlWindow = SDL_CreateWindow(params.title.c_str(),
-                               params.x,
-                               params.y,
-                               params.w,
-                               params.h,
-                               SDL_WINDOW_SHOWN);
-  Uint32 rendererFlags = SDL_RENDERER_PRESENTVSYNC;
-  rendererFlags |= (params.mode == DrawMode::GPU) ? SDL_RENDERER_ACCELERATED
-                                                  : SDL_RENDERER_SOFTWARE;
-  sdlRenderer = SDL_CreateRenderer(sdlWindow, -1, rendererFlags);
+  SDL2W_ZONE("Window::createWindow");
+
+  headless = params.headless;
+  Uint32 format = SDL_PIXELFORMAT_ARGB8888;
+  if (headless) {
+    LOG(DEBUG) << "[sdl2w] Create headless window:"
+               << " " << params.w << " " << params.h << Logger::endl;
+
+    // offscreen surface + software renderer, no OS window or vsync
+    headlessSurface = std::unique_ptr<SDL_Surface, SDL_Deleter>(
+        SDL_CreateRGBSurfaceWithFormat(0, params.w, params.h, 32, format));
+    if (headlessSurface == nullptr) {
+      LOG_LINE(ERROR) << "[sdl2w] Could not create headless surface! "
+                      << SDL_GetError() << Logger::endl;
+      throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+    }
+    sdlRenderer = SDL_CreateSoftwareRenderer(headlessSurface.get());
+    if (sdlRenderer == nullptr) {
+      LOG_LINE(ERROR) << "[sdl2w] Could not create headless renderer! "
+                      << SDL_GetError() << Logger::endl;
+      throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+    }
+    drawMode = DrawMode::CPU;
+  } else {
+    LOG(DEBUG) << "[sdl2w] Create window:"
+               << " " << params.w << " " << params.h << Logger::endl;
+
+    // create window and renderer
+    sdlWindow = SDL_CreateWindow(params.title.c_str(),
+                                 params.x,
+                                 params.y,
+                                 params.w,
+                                 params.h,
+                                 SDL_WINDOW_SHOWN);
+    drawMode = params.mode;
+    int driverIndex = -1;
+    if (drawMode == DrawMode::AUTO) {
+      const RendererChoice choice = RendererProbe::choose(
+          sdlWindow, params.renderW, params.renderH, params.drawModeCachePath);
+      drawMode = choice.software ? DrawMode::CPU : DrawMode::GPU;
+      driverIndex = choice.driverIndex;
+    }
+    Uint32 rendererFlags = params.presentMode == PresentMode::VSYNC_OFF
+                               ? 0
+                               : SDL_RENDERER_PRESENTVSYNC;
+    rendererFlags |= (drawMode == DrawMode::GPU) ? SDL_RENDERER_ACCELERATED
+                                                 : SDL_RENDERER_SOFTWARE;
+    sdlRenderer = SDL_CreateRenderer(sdlWindow, driverIndex, rendererFlags);
+    if (sdlRenderer == nullptr && driverIndex != -1) {
+      LOG(WARN) << "[sdl2w] Could not create the probed renderer, letting SDL "
+                   "pick one. "
+                << SDL_GetError() << Logger::endl;
+      sdlRenderer = SDL_CreateRenderer(sdlWindow, -1, rendererFlags);
+    }
+    if (params.presentMode == PresentMode::VSYNC_ADAPTIVE &&
+        SDL_GL_SetSwapInterval(-1) != 0) {
+      LOG(WARN) << "[sdl2w] Adaptive vsync is not supported by this renderer, "
+                   "using vsync. "
+                << SDL_GetError() << Logger::endl;
+    }
+    format = SDL_GetWindowPixelFormat(sdlWindow);
+  }
+  targetFps = params.targetFps;
+  frameLimiter.setTargetFps(targetFps);
   SDL_RenderSetLogicalSize(sdlRenderer, params.renderW, params.renderH);
   SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest"); // or "nearest"
-  Uint32 format = SDL_GetWindowPixelFormat(sdlWindow);
   draw.setSdlRenderer(sdlRenderer, params.renderW, params.renderH, format);
+  draw.setDirectPresent(params.directPresent);
+  if (params.rasterBackend) {
+    if (drawMode == DrawMode::CPU) {
+      draw.setRasterThreads(params.rasterThreads);
+      draw.setRasterBackend(true);
+    } else {
+      LOG(INFO) << "[sdl2w] The raster backend is only used with "
+                   "DrawMode::CPU"
+                << Logger::endl;
+    }
+  }
 
-  Mix_AllocateChannels(numSoundChannels);
+  Subsystems::setNumSoundChannels(numSoundChannels);
 
   windowWidth = params.w;
   windowHeight = params.h;
@@ -69,30 +139,52 @@ Window::Window(Store& store, const Window2Params& params)
   emshelpers::setEmscriptenWindow(this);
 }
 
-Window::~Window() {}
+Window::~Window() {
+  PerfOverlay::releaseGlyphs(sdlRenderer);
+  if (headless && sdlRenderer != nullptr) {
+    // The renderer draws into headlessSurface, which is freed with this
+    // Window, so it goes too.  SDL destroys every texture still created from
+    // it; the Store's must have been cleared by now (see Window2Params).
+    draw.releaseSdlRenderer();
+    SDL_DestroyRenderer(sdlRenderer);
+    sdlRenderer = nullptr;
+  }
+}
 
 bool Window::isReady() const { return _isInit && AssetLoader::fsReady; }
 
 void Window::setSoundPct(int pct) {
   soundPct = pct;
-  if (!_soundEnabled) {
+  if (!_soundEnabled || !Subsystems::isAudioReady()) {
     return;
   }
-  Mix_Volume(
-      -1, static_cast<int>(double(soundPct) / 100.0 * double(MIX_MAX_VOLUME)));
+  Mix_Volume(-1, getMixVolume(soundPct));
 }
 
 void Window::setMusicPct(int pct) {
   musicPct = pct;
-  if (!_soundEnabled) {
+  if (!_soundEnabled || !Subsystems::isAudioReady()) {
     return;
   }
-  Mix_VolumeMusic(
-      static_cast<int>(double(musicPct) / 100.0 * double(MIX_MAX_VOLUME)));
+  Mix_VolumeMusic(getMixVolume(musicPct));
+}
+
+int Window::getMixVolume(int pct) const {
+  const int duckPct = audioDucked ? backgroundParams.duckPct : 100;
+  return static_cast<int>(double(pct) / 100.0 * double(duckPct) / 100.0 *
+                          double(MIX_MAX_VOLUME));
+}
+
+void Window::applyVolumes() {
+  if (!_soundEnabled || !Subsystems::isAudioReady()) {
+    return;
+  }
+  Mix_Volume(-1, getMixVolume(soundPct));
+  Mix_VolumeMusic(getMixVolume(musicPct));
 }
 
 void Window::playSound(std::string_view name) {
-  if (!_soundEnabled) {
+  if (!_soundEnabled || !Subsystems::ensureAudio()) {
     return;
   }
 
@@ -103,13 +195,11 @@ void Window::playSound(std::string_view name) {
               << " err=" << SDL_GetError() << Logger::endl;
     return;
   }
-  Mix_Volume(
-      channel,
-      static_cast<int>(double(soundPct) / 100.0 * double(MIX_MAX_VOLUME)));
+  Mix_Volume(channel, getMixVolume(soundPct));
 }
 
 void Window::playMusic(std::string_view name) {
-  if (!_soundEnabled) {
+  if (!_soundEnabled || !Subsystems::ensureAudio()) {
     return;
   }
 
@@ -120,18 +210,17 @@ void Window::playMusic(std::string_view name) {
     return;
   }
   Mix_PlayMusic(music, -1);
-  Mix_VolumeMusic(
-      static_cast<int>(double(musicPct) / 100.0 * double(MIX_MAX_VOLUME)));
+  Mix_VolumeMusic(getMixVolume(musicPct));
 }
 
 void Window::stopMusic() {
-  if (Mix_PlayingMusic()) {
+  if (Subsystems::isAudioReady() && Mix_PlayingMusic()) {
     Mix_HaltMusic();
   }
 }
 
 bool Window::isMusicPlaying() const {
-  if (Mix_PlayingMusic()) {
+  if (Subsystems::isAudioReady() && Mix_PlayingMusic()) {
     return true;
   }
   return false;
@@ -145,30 +234,37 @@ std::pair<int, int> Window::getRenderDims() const {
   return std::make_pair(renderWidth, renderHeight);
 }
 
-void Window::init() {
+void Window::init(const WindowInitParams& params) {
   if (_isInit) {
     LOG(WARN) << "[sdl2w] SDL is already initialized." << Logger::endl;
     return;
   }
 
-  LOG(DEBUG) << "[sdl2w] Init SDL" << Logger::endl;
+  if (params.startupReport) {
+    Profiler::beginStartup();
+  }
+  LOG(DEBUG) << "[sdl2w] Init SDL" << (params.headless ? " (headless)" : "")
+             << Logger::endl;
+
+  if (params.headless) {
+    // don't overwrite, so a driver picked in the environment still wins
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+  }
 
   // SDL_Init(SDL_INIT_TIMER | SDL_INIT_AUDIO | SDL_INIT_VIDEO |
   //          SDL_INIT_JOYSTICK | SDL_INIT_GAMECONTROLLER | SDL_INIT_EVENTS);
 
-  SDL_Init(SDL_INIT_TIMER | SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_EVENTS);
-
-  // initialize fonts
-  if (TTF_Init() < 0) {
-    LOG_LINE(ERROR) << "[sdl2w] SDL_ttf could not initialize! "
-                    << std::string(TTF_GetError()) << Logger::endl;
-    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  {
+    SDL2W_ZONE("SDL_Init");
+    SDL_Init(SDL_INIT_TIMER | SDL_INIT_VIDEO | SDL_INIT_EVENTS |
+             (params.lazyAudio ? 0 : SDL_INIT_AUDIO));
   }
 
-  // initialize audio
-  if (Mix_OpenAudio(MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, 1, 1024) < 0) {
-    LOG_LINE(ERROR) << "[sdl2w] SDL_mixer could not initialize! "
-                    << std::string(Mix_GetError()) << Logger::endl;
+  if (!params.lazyTtf) {
+    Subsystems::ensureTtf();
+  }
+  if (!params.lazyAudio && !Subsystems::ensureAudio()) {
     _soundEnabled = false;
   }
 
@@ -179,39 +275,51 @@ void Window::unInit() {
   if (_isInit) {
     LOG(DEBUG) << "[sdl2w] UnInit SDL" << Logger::endl;
 
-    TTF_Quit();
-    Mix_CloseAudio();
-    Mix_Quit();
+    Subsystems::quit();
     SDL_Quit();
     _isInit = false;
   }
 }
 
 void Window::renderLoop() {
-  const Uint64 div = 1000;
-  const Uint64 nowMicroSeconds = SDL_GetPerformanceCounter();
-  auto freq = SDL_GetPerformanceFrequency();
-  now = (nowMicroSeconds * div) / freq;
+  SDL2W_ZONE("Window::renderLoop");
+  if (clock.isFinished()) {
+    LOG(INFO) << "[sdl2w] Frame clock replay finished after " << frameCount
+              << " frames" << Logger::endl;
+    isLooping = false;
+    return;
+  }
 
-  if (!static_cast<bool>(freq)) {
-    freq = 1;
+  waitWhileIdle();
+  if (redrawFrames > 0) {
+    redrawFrames--;
   }
+
+  const double clockDeltaTime = clock.tick();
+  now = static_cast<uint64_t>(clock.getElapsedMs());
   if (firstLoop) {
     deltaTime = 16.6666;
   } else {
-    deltaTime = static_cast<double>((nowMicroSeconds - lastFrameTime) * div) /
-                static_cast<double>(freq);
+    deltaTime = clockDeltaTime;
   }
-
-  lastFrameTime = nowMicroSeconds;
-  pastFrameTimes.push_back(deltaTime);
-  if (pastFrameTimes.size() > 10) {
-    pastFrameTimes.pop_front();
+  frameCount++;
+
+  // the previous frame's total includes everything up to this point, so it is
+  // only recorded now
+  const uint64_t frameStart = SDL_GetPerformanceCounter();
+  if (pendingSampleStart != 0) {
+    // time spent idle is not part of any frame
+    pendingSample.totalMs =
+        countsToMs(frameStart - pendingSampleStart - idleCounts);
+    frameStats.push(pendingSample);
   }
+  pendingSample = FrameSample{.frame = frameCount};
+  pendingSampleStart = frameStart;
 
   SDL_Event e;
   while (SDL_PollEvent(&e) != 0) {
     // empty event queue
+    redrawFrames = std::max(redrawFrames, idleParams.trailingFrames);
     if (!_inputEnabled) {
       continue;
     }
@@ -224,13 +332,15 @@ void Window::renderLoop() {
     if (e.type == SDL_QUIT) {
       isLooping = false;
       break;
-    } else if (e.window.event == SDL_WINDOWEVENT_FOCUS_GAINED) {
-      break;
-    } else if (e.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
-      break;
     }
 #endif
-    else if (e.type == SDL_KEYDOWN) {
+    else if (e.type == SDL_WINDOWEVENT) {
+      handleWindowEvent(e.window.event);
+    } else if (e.type == SDL_KEYDOWN) {
+      if (perfOverlayToggleKey != 0 &&
+          e.key.keysym.sym == perfOverlayToggleKey && !e.key.repeat) {
+        perfOverlayEnabled = !perfOverlayEnabled;
+      }
       events.keydown(e.key.keysym.sym);
     } else if (e.type == SDL_KEYUP) {
       events.keyup(e.key.keysym.sym);
@@ -258,9 +368,17 @@ void Window::renderLoop() {
     }
     events.handleEvent(e);
   }
+  const uint64_t eventsEnd = SDL_GetPerformanceCounter();
+  pendingSample.eventsMs = countsToMs(eventsEnd - frameStart);
+  SDL2W_ZONE_SPAN("Window::events", frameStart, eventsEnd);
   if (!isLooping) {
     return;
   }
+  if (backgroundPolicy == BG_SUSPEND) {
+    // this wakeup only handled events; it is not a frame
+    pendingSampleStart = 0;
+    return;
+  }
 
   if (initTimeMax > initTime) {
     initTime += deltaTime;
@@ -276,10 +394,257 @@ void Window::renderLoop() {
   } else {
     isLooping = initializingCb();
   }
+  const uint64_t updateEnd = SDL_GetPerformanceCounter();
+  pendingSample.updateMs = countsToMs(updateEnd - eventsEnd);
+  SDL2W_ZONE_SPAN("Window::update", eventsEnd, updateEnd);
+
+  const bool skipPresent = (fastForward && fastForwardSkipPresent) ||
+                           backgroundPolicy == BG_UPDATE_ONLY;
+  if (!skipPresent) {
+    // the overlay's own cost is left out of every phase it reports
+    uint64_t drawStart = updateEnd;
+    if (perfOverlayEnabled || perfOverlayDrawn) {
+      // the overlay draws on the renderer directly, outside dirty-rect
+      // tracking, so those frames (and the one after) are redrawn in full
+      draw.invalidate();
+    }
+    perfOverlayDrawn = perfOverlayEnabled;
+    if (perfOverlayEnabled) {
+      draw.flushRecorded();
+      perfOverlay.render(frameStats, deltaTime);
+      drawStart = SDL_GetPerformanceCounter();
+      SDL2W_ZONE_SPAN("Window::perfOverlay", updateEnd, drawStart);
+    }
+    draw.compositeIntermediate();
+    const uint64_t drawEnd = SDL_GetPerformanceCounter();
+    pendingSample.drawMs = countsToMs(drawEnd - drawStart);
+    SDL2W_ZONE_SPAN("Window::composite", drawStart, drawEnd);
+    draw.present();
+    const uint64_t presentEnd = SDL_GetPerformanceCounter();
+    pendingSample.presentMs = countsToMs(presentEnd - drawEnd);
+    SDL2W_ZONE_SPAN("Window::present", drawEnd, presentEnd);
+
+    const DrawCounters& counters = draw.getLastFrameCounters();
+    pendingSample.drawCalls = counters.drawCalls;
+    pendingSample.textureSwitches = counters.textureSwitches;
+    pendingSample.primitiveCalls = counters.primitiveCalls;
+    pendingSample.textCacheMisses = counters.textCacheMisses;
+    pendingSample.culledDraws = counters.culledDraws;
+    pendingSample.renderScale = draw.getRenderScale();
+    if (draw.isAdaptiveResolution()) {
+      draw.reportFrameTime(pendingSample.updateMs + pendingSample.drawMs);
+    }
+  } else if (draw.isDirtyRectMode() || draw.isRasterBackend()) {
+    // nothing is presented, so drop what was recorded (dirty-rect mode also
+    // redraws in full once presenting resumes)
+    draw.invalidate();
+    draw.clearScreen();
+  }
+  if (Profiler::isCapturingStartup()) {
+    Profiler::endStartup();
+  }
 
-  draw.renderIntermediate();
+#ifndef __EMSCRIPTEN__
+  if (!fastForward) {
+    SDL2W_ZONE("Window::frameLimiter");
+    frameLimiter.wait();
+    waitDisplayRefresh();
+  }
+#endif
 }
 
+void Window::waitDisplayRefresh() {
+  // Without damage Draw::present skips SDL_RenderPresent, so vsync no longer
+  // blocks the loop; wait out a refresh instead of spinning on a static
+  // screen.  A target fps already paces the loop, and headless windows have
+  // no display to wait for.
+  if (!draw.isDirtyRectMode() || !draw.getDirtyRectStats().skippedPresent ||
+      frameLimiter.isEnabled() || headless) {
+    refreshLimiter.reset();
+    return;
+  }
+  SDL_DisplayMode mode;
+  int refreshRate = 60;
+  if (SDL_GetWindowDisplayMode(sdlWindow, &mode) == 0 &&
+      mode.refresh_rate > 0) {
+    refreshRate = mode.refresh_rate;
+  }
+  if (refreshRate != refreshLimiter.getTargetFps()) {
+    refreshLimiter.setTargetFps(refreshRate);
+  }
+  SDL2W_ZONE("Window::waitDisplayRefresh");
+  refreshLimiter.wait();
+}
+
+bool Window::runFixedSteps() {
+  const double stepMs = fixedParams.stepMs;
+  fixedAccumulator += std::min(deltaTime, fixedParams.maxFrameTimeMs);
+
+  bool keepLooping = true;
+  int steps = 0;
+  while (fixedAccumulator >= stepMs) {
+    if (steps >= fixedParams.maxStepsPerFrame) {
+      fixedAccumulator = std::fmod(fixedAccumulator, stepMs);
+      break;
+    }
+    keepLooping = fixedUpdateCb(stepMs);
+    fixedAccumulator -= stepMs;
+    steps++;
+    if (!keepLooping) {
+      break;
+    }
+  }
+
+  renderAlpha = fixedAccumulator / stepMs;
+  fixedRenderCb(renderAlpha);
+  return keepLooping;
+}
+
+void Window::handleWindowEvent(int windowEvent) {
+  switch (windowEvent) {
+  case SDL_WINDOWEVENT_FOCUS_GAINED:
+    focused = true;
+    break;
+  case SDL_WINDOWEVENT_FOCUS_LOST:
+    focused = false;
+    break;
+  case SDL_WINDOWEVENT_MINIMIZED:
+  case SDL_WINDOWEVENT_HIDDEN:
+    hidden = true;
+    break;
+  case SDL_WINDOWEVENT_RESTORED:
+  case SDL_WINDOWEVENT_MAXIMIZED:
+  case SDL_WINDOWEVENT_SHOWN:
+    hidden = false;
+    break;
+  case SDL_WINDOWEVENT_EXPOSED:
+  case SDL_WINDOWEVENT_SIZE_CHANGED:
+    // the window's pixels may be gone, which dirty-rect mode can't see
+    draw.invalidate();
+    break;
+  default:
+    return;
+  }
+  updateBackgroundPolicy();
+}
+
+void Window::updateBackgroundPolicy() {
+  BackgroundPolicy policy = BG_RUN;
+  int fps = 0;
+  if (hidden) {
+    policy = backgroundParams.hidden;
+    fps = backgroundParams.hiddenFps;
+  } else if (!focused) {
+    policy = backgroundParams.unfocused;
+    fps = backgroundParams.unfocusedFps;
+  }
+  // a lower cap set by the game still applies in the background
+  if (policy == BG_RUN || (targetFps > 0 && (fps <= 0 || targetFps < fps))) {
+    fps = targetFps;
+  }
+  if (fps != frameLimiter.getTargetFps()) {
+    frameLimiter.setTargetFps(fps);
+  }
+
+  if (policy != backgroundPolicy) {
+    LOG(DEBUG) << "[sdl2w] Background policy " << backgroundPolicy << " -> "
+               << policy << Logger::endl;
+    backgroundPolicy = policy;
+  }
+
+  const bool duck = (hidden || !focused) && backgroundParams.duckPct != 100;
+  if (duck != audioDucked) {
+    audioDucked = duck;
+    applyVolumes();
+  }
+}
+
+void Window::setTargetFps(int fps) {
+  targetFps = fps;
+  updateBackgroundPolicy();
+}
+
+void Window::setBackgroundParams(const BackgroundParams& params) {
+  if (params.unfocusedFps < 0 || params.hiddenFps < 0 ||
+      params.duckPct < 0 || params.duckPct > 100) {
+    LOG_LINE(ERROR) << "[sdl2w] Invalid background params: unfocusedFps="
+                    << params.unfocusedFps
+                    << " hiddenFps=" << params.hiddenFps
+                    << " duckPct=" << params.duckPct << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  backgroundParams = params;
+  updateBackgroundPolicy();
+  // duckPct may have changed while already ducked
+  applyVolumes();
+}
+
+bool Window::shouldIdle() const {
+  if (!idleEnabled || firstLoop || fastForward || perfOverlayEnabled ||
+      clock.getMode() != CLOCK_REAL) {
+    return false;
+  }
+  if (redrawFrames > 0 || events.isInputHeld()) {
+    return false;
+  }
+  return SDL_GetPerformanceCounter() >= redrawUntil;
+}
+
+void Window::waitWhileIdle() {
+  idleCounts = 0;
+#ifndef __EMSCRIPTEN__
+  const bool suspended = backgroundPolicy == BG_SUSPEND;
+  if (!suspended && !shouldIdle()) {
+    return;
+  }
+  SDL2W_ZONE("Window::idle");
+  const uint64_t idleStart = SDL_GetPerformanceCounter();
+  // the event is left in the queue for renderLoop to handle
+  if (!suspended && idleParams.maxWaitMs > 0) {
+    SDL_WaitEventTimeout(nullptr, idleParams.maxWaitMs);
+  } else {
+    SDL_WaitEvent(nullptr);
+  }
+  idleCounts = SDL_GetPerformanceCounter() - idleStart;
+  if (suspended) {
+    // game time stands still while suspended
+    clock.resync();
+  }
+  // don't try to catch up on the deadlines that passed while waiting
+  frameLimiter.reset();
+#endif
+}
+
+void Window::setIdleMode(bool enabled, const IdleParams& params) {
+  if (params.maxWaitMs < 0 || params.trailingFrames < 0) {
+    LOG_LINE(ERROR) << "[sdl2w] Invalid idle params: maxWaitMs="
+                    << params.maxWaitMs
+                    << " trailingFrames=" << params.trailingFrames
+                    << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+#ifdef __EMSCRIPTEN__
+  if (enabled) {
+    LOG(WARN) << "[sdl2w] Idle mode is not available under Emscripten."
+              << Logger::endl;
+  }
+#endif
+  idleEnabled = enabled;
+  idleParams = params;
+  requestRedraw();
+}
+
+void Window::requestRedrawFor(double ms) {
+  const double counts = std::max(ms, 0.) *
+                        static_cast<double>(SDL_GetPerformanceFrequency()) /
+                        1000.;
+  const uint64_t until =
+      SDL_GetPerformanceCounter() + static_cast<uint64_t>(counts);
+  redrawUntil = std::max(redrawUntil, until);
+}
+
+double Window::getLastIdleMs() const { return countsToMs(idleCounts); }
+
 void Window::setInitTimeMax(int max) { initTimeMax = max; }
 
 #ifdef __EMSCRIPTEN__
@@ -293,10 +658,16 @@ void Window::startRenderLoop(std::function<bool(void)> _initializingCb,
   initializingCb = _initializingCb;
   loopCb = _loopCb;
   onInitCb = _onInitCb;
-  Window::now = SDL_GetPerformanceCounter();
+  clock.reset();
+  now = 0;
+  frameCount = 0;
+  pendingSampleStart = 0;
+  frameLimiter.reset();
 
 #ifdef __EMSCRIPTEN__
-  emscripten_set_main_loop_arg(&RenderLoopCallback, this, -1, 1);
+  // the browser paces frames itself; -1 means requestAnimationFrame
+  const int fps = frameLimiter.isEnabled() ? frameLimiter.getTargetFps() : -1;
+  emscripten_set_main_loop_arg(&RenderLoopCallback, this, fps, 1);
 #else
   while (isLooping) {
     renderLoop();
@@ -304,4 +675,23 @@ void Window::startRenderLoop(std::function<bool(void)> _initializingCb,
 #endif
 }
 
+void Window::startFixedRenderLoop(std::function<bool(void)> _initializingCb,
+                                  std::function<void(void)> _onInitCb,
+                                  std::function<bool(double)> _updateCb,
+                                  std::function<void(double)> _renderCb,
+                                  const FixedTimestepParams& params) {
+  if (params.stepMs <= 0.) {
+    LOG_LINE(ERROR) << "[sdl2w] Fixed timestep must be positive: "
+                    << params.stepMs << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  fixedParams = params;
+  fixedAccumulator = 0.;
+  renderAlpha = 0.;
+  fixedUpdateCb = _updateCb;
+  fixedRenderCb = _renderCb;
+  startRenderLoop(
+      _initializingCb, _onInitCb, [this]() { return runFixedSteps(); });
+}
+
 } // namespace sdl2w
\ No newline at end of file
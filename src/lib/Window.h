@@ -2,9 +2,14 @@
 
 #include "Draw.h"
 #include "Events.h"
+#include "FrameClock.h"
+#include "FrameLimiter.h"
+#include "FrameStats.h"
+#include "PerfOverlay.h"
 #include "Store.h"
-#include <deque>
+#include <algorithm>
 #include <functional>
+#include <memory>
 #include <string>
 #include <string_view>
 
@@ -12,6 +17,28 @@ namespace sdl2w {
 
 constexpr const char* FONT_DEFAULT = "default";
 
+enum PresentMode {
+  VSYNC_ON,
+  VSYNC_OFF,
+  // late frames tear instead of waiting a whole refresh; falls back to
+  // VSYNC_ON where the renderer can't do it
+  VSYNC_ADAPTIVE,
+};
+
+struct WindowInitParams {
+  // use SDL's dummy video and audio drivers so no display or sound device is
+  // needed (build agents, perf harnesses)
+  bool headless = false;
+  // Defer SDL_ttf / the audio device and SDL_mixer until the first font load
+  // or sound load/playback (see Subsystems).
+  bool lazyTtf = false;
+  bool lazyAudio = false;
+  // capture zones until the first frame for the startup report (see
+  // Profiler::beginStartup); off for tools and benchmarks without a render
+  // loop
+  bool startupReport = true;
+};
+
 struct Window2Params {
   DrawMode mode = DrawMode::GPU;
   std::string title;
@@ -21,6 +48,77 @@ struct Window2Params {
   int y;
   int renderW;
   int renderH;
+  // Render with the software renderer into an offscreen surface instead of an
+  // OS window; there is no vsync and present only touches the surface.  The
+  // renderer is destroyed with the Window, and every texture created from it
+  // with it: clear the Store and drop RenderLayers and TileMaps first.
+  bool headless = false;
+  PresentMode presentMode = PresentMode::VSYNC_ON;
+  // cap the loop at this rate with FrameLimiter, 0 for no cap
+  int targetFps = 0;
+  // draw frames straight to the backbuffer when possible, see
+  // Draw::setDirectPresent
+  bool directPresent = false;
+  // with DrawMode::CPU, draw with Draw's SIMD rasterizer instead of issuing
+  // every draw to the software renderer, see Draw::setRasterBackend
+  bool rasterBackend = false;
+  // threads the raster backend draws frames with, 0 for one per hardware
+  // thread, see Draw::setRasterThreads
+  int rasterThreads = 0;
+  // where DrawMode::AUTO caches its choice, "" to benchmark on every start
+  std::string drawModeCachePath = "sdl2w_drawmode.txt";
+};
+
+struct FixedTimestepParams {
+  double stepMs = 1000. / 60.;
+  // Past this many updates in one frame the remaining backlog is dropped, so
+  // a slow update can't snowball into ever longer frames.
+  int maxStepsPerFrame = 5;
+  // frame deltas are clamped to this before being accumulated (e.g. after a
+  // breakpoint or a window drag)
+  double maxFrameTimeMs = 250.;
+};
+
+// What the loop does while the window is in the background.  Throttling
+// only applies where Window paces the loop itself (not under Emscripten,
+// where the browser already slows down hidden pages).
+enum BackgroundPolicy {
+  BG_RUN,
+  // update and render at the policy's fps
+  BG_THROTTLE,
+  // update at the policy's fps but don't render or present
+  BG_UPDATE_ONLY,
+  // stop updating until the window is back; game time does not advance
+  BG_SUSPEND,
+};
+
+struct BackgroundParams {
+  // focus lost but still visible, e.g. next to another instance
+  BackgroundPolicy unfocused = BG_RUN;
+  int unfocusedFps = 15;
+  // minimized or hidden
+  BackgroundPolicy hidden = BG_RUN;
+  int hiddenFps = 5;
+  // sound and music volume while in the background, in percent of the
+  // volume set with setSoundPct/setMusicPct
+  int duckPct = 100;
+};
+
+// Idle mode blocks the render loop while nothing is happening instead of
+// rendering identical frames.  A frame is rendered when an SDL event arrives,
+// while a key or mouse button is held, after requestRedraw() and until a
+// requestRedrawFor() window runs out; otherwise the loop waits for the next
+// event.  Animations and timers belong to the game, which must request
+// redraws while they run.  The frame after a wait reports the whole wait as
+// its delta time, so timers advanced by it still run on time.  Not available
+// under Emscripten, where the browser drives the loop.
+struct IdleParams {
+  // the loop still wakes this often with no event, so code polling timers or
+  // files gets a turn; 0 waits for an event indefinitely
+  int maxWaitMs = 1000;
+  // frames rendered after the last event before idling again, so state that
+  // changes a frame after input (route pushes, releases) is drawn
+  int trailingFrames = 2;
 };
 
 struct ExternalEvent {
@@ -32,18 +130,32 @@ class Window {
   Store& store;
   Draw draw;
   Events events;
-  std::deque<double> pastFrameTimes;
+  PerfOverlay perfOverlay;
+  FrameLimiter frameLimiter;
+  // paces dirty-rect frames that presented nothing, which vsync doesn't
+  FrameLimiter refreshLimiter;
+  FrameClock clock;
+  FrameStats frameStats;
+  FrameSample pendingSample;
+  uint64_t pendingSampleStart = 0;
   std::function<bool(void)> initializingCb;
   std::function<void(void)> onInitCb;
   std::function<bool(void)> loopCb;
+  std::function<bool(double)> fixedUpdateCb;
+  std::function<void(double)> fixedRenderCb;
+  FixedTimestepParams fixedParams;
+  double fixedAccumulator = 0.;
+  double renderAlpha = 0.;
   std::vector<ExternalEvent> externalEvents;
 
   std::pair<int, int> mousePos;
-  uint64_t now;
-  uint64_t lastFrameTime = 0;
+  uint64_t now = 0;
+  uint64_t frameCount = 0;
   double deltaTime = 0.;
   SDL_Window* sdlWindow = nullptr;
   SDL_Renderer* sdlRenderer = nullptr;
+  DrawMode drawMode = DrawMode::GPU;
+  std::unique_ptr<SDL_Surface, SDL_Deleter> headlessSurface;
   int windowWidth = 0;
   int windowHeight = 0;
   int renderWidth = 0;
@@ -55,24 +167,98 @@ class Window {
   int initTimeMax = 500;
   bool firstLoop = true;
   bool isLooping = false;
+  bool headless = false;
+  bool fastForward = false;
+  bool fastForwardSkipPresent = false;
+  bool perfOverlayEnabled = false;
+  int targetFps = 0;
+  BackgroundParams backgroundParams;
+  BackgroundPolicy backgroundPolicy = BG_RUN;
+  bool focused = true;
+  bool hidden = false;
+  bool audioDucked = false;
+  bool idleEnabled = false;
+  IdleParams idleParams;
+  int redrawFrames = 0;
+  uint64_t redrawUntil = 0;
+  uint64_t idleCounts = 0;
+  // drawn last frame, so dirty-rect mode must redraw the area it covered
+  bool perfOverlayDrawn = false;
+  int perfOverlayToggleKey = 0;
 
   static bool _isInit;
 
+  bool runFixedSteps();
+  void handleWindowEvent(int windowEvent);
+  void updateBackgroundPolicy();
+  int getMixVolume(int pct) const;
+  void applyVolumes();
+  bool shouldIdle() const;
+  void waitWhileIdle();
+  void waitDisplayRefresh();
+
 public:
   static bool isInit();
-  static void init();
+  static void init(const WindowInitParams& params = WindowInitParams());
   static void unInit();
   static bool _soundEnabled;
   static bool _inputEnabled;
 
   Window(Store& store, const Window2Params& params);
+  // Headless windows destroy their renderer and its textures here, see
+  // Window2Params::headless.  The Store is left alone.
   ~Window();
 
   Draw& getDraw() { return draw; }
+  // CPU or GPU, also when created with DrawMode::AUTO
+  DrawMode getDrawMode() const { return drawMode; }
+  // nullptr when headless
+  SDL_Window* getSdlWindow() { return sdlWindow; }
   Store& getStore() { return store; }
   Events& getEvents() { return events; }
+  const FrameLimiter& getFrameLimiter() const { return frameLimiter; }
+  void setTargetFps(int fps);
+  // Source of frame delta times: real, fixed-step virtual or replayed.
+  FrameClock& getClock() { return clock; }
+  FrameStats& getFrameStats() { return frameStats; }
+  PerfOverlay& getPerfOverlay() { return perfOverlay; }
+  void setPerfOverlayEnabled(bool enabled) { perfOverlayEnabled = enabled; }
+  bool isPerfOverlayEnabled() const { return perfOverlayEnabled; }
+  // SDL keycode that toggles the overlay, e.g. SDLK_F3; 0 (the default) for
+  // none.  The key still reaches Events.  While shown, the overlay keeps idle
+  // mode from sleeping and dirty-rect mode redraws the area it covers.
+  void setPerfOverlayToggleKey(int keycode) { perfOverlayToggleKey = keycode; }
+  // Run frames back to back, ignoring the frame limiter, and optionally skip
+  // renderIntermediate (and so present/vsync) entirely.  Pair with a virtual
+  // clock and headless mode for soak and perf tests of game logic.
+  void setFastForward(bool enabled, bool skipPresent = false) {
+    fastForward = enabled;
+    fastForwardSkipPresent = skipPresent;
+  }
+  bool isFastForward() const { return fastForward; }
+  void setBackgroundParams(const BackgroundParams& params);
+  const BackgroundParams& getBackgroundParams() const {
+    return backgroundParams;
+  }
+  // the policy in effect right now, BG_RUN while focused
+  BackgroundPolicy getBackgroundPolicy() const { return backgroundPolicy; }
+  bool isFocused() const { return focused; }
+  // minimized or hidden
+  bool isHidden() const { return hidden; }
+  void setIdleMode(bool enabled, const IdleParams& params = {});
+  bool isIdleMode() const { return idleEnabled; }
+  // Render at least the next frame in idle mode.
+  void requestRedraw() { redrawFrames = std::max(redrawFrames, 1); }
+  // Keep rendering every frame for the next ms, e.g. while a transition or
+  // notification is on screen.
+  void requestRedrawFor(double ms);
+  // how long the loop waited for activity before the current frame
+  double getLastIdleMs() const;
+  uint64_t getFrameCount() const { return frameCount; }
+  void stopRenderLoop() { isLooping = false; }
   void pushExternalEvent(int event, std::string payload) {
     externalEvents.push_back({event, payload});
+    requestRedraw();
   }
   void processExternalEvents(std::function<void(int, std::string)> callback) {
     for (auto& event : externalEvents) {
@@ -81,6 +267,10 @@ public:
     externalEvents.clear();
   }
   bool isReady() const;
+  bool isHeadless() const { return headless; }
+  // The surface the headless renderer presents into; holds the last presented
+  // frame for pixel checks.  nullptr when not headless.
+  SDL_Surface* getHeadlessSurface() { return headlessSurface.get(); }
   void setSoundPct(int pct);
   int getSoundPct() const { return soundPct; }
   void setMusicPct(int pct);
@@ -92,12 +282,23 @@ public:
   std::pair<int, int> getDims() const;
   std::pair<int, int> getRenderDims() const;
   int getDeltaTime() const { return static_cast<int>(deltaTime); }
+  double getDeltaTimeMs() const { return deltaTime; }
+  // how far between the last two fixed updates the current render is, [0, 1)
+  double getRenderAlpha() const { return renderAlpha; }
 
   void renderLoop();
   void setInitTimeMax(int max);
   void startRenderLoop(std::function<bool(void)> _initializingCb,
                        std::function<void(void)> _onInitCb,
                        std::function<bool(void)> _loopCb);
+  // Runs _updateCb(stepMs) zero or more times per frame from an accumulator of
+  // real elapsed time, then _renderCb(alpha) once with the interpolation
+  // factor between the previous and current simulation states.
+  void startFixedRenderLoop(std::function<bool(void)> _initializingCb,
+                            std::function<void(void)> _onInitCb,
+                            std::function<bool(double)> _updateCb,
+                            std::function<void(double)> _renderCb,
+                            const FixedTimestepParams& params = {});
 };
 
 } // namespace sdl2w
\ No newline at end of file
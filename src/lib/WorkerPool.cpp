@@ -0,0 +1,104 @@
+#include "WorkerPool.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace sdl2w {
+
+int WorkerPool::getHardwareThreads() {
+#ifdef __EMSCRIPTEN__
+  return 1;
+#else
+  const int n = static_cast<int>(std::thread::hardware_concurrency());
+  return n > 0 ? n : 1;
+#endif
+}
+
+WorkerPool::WorkerPool(int numThreads) {
+  if (numThreads <= 0) {
+    numThreads = getHardwareThreads();
+  }
+#ifndef __EMSCRIPTEN__
+  for (int i = 1; i < numThreads; i++) {
+    threads.emplace_back(&WorkerPool::workerMain, this);
+  }
+#endif
+  LOG(DEBUG) << "[sdl2w] Created WorkerPool with " << getNumThreads()
+             << " thread(s)" << Logger::endl;
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  workCv.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// Runs one chunk of the current job if any remain.  Called with the lock held;
+// the lock is released while the chunk itself executes.
+bool WorkerPool::runNextChunk(std::unique_lock<std::mutex>& lock) {
+  if (nextChunk >= numChunks) {
+    return false;
+  }
+  const int chunk = nextChunk++;
+  const int begin = chunk * jobChunkSize;
+  const int end = std::min(jobCount, begin + jobChunkSize);
+  lock.unlock();
+  job(begin, end);
+  lock.lock();
+  chunksDone++;
+  if (chunksDone == numChunks) {
+    doneCv.notify_all();
+  }
+  return true;
+}
+
+void WorkerPool::workerMain() {
+  unsigned int seenGeneration = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    workCv.wait(lock,
+                [&] { return stopping || generation != seenGeneration; });
+    if (stopping) {
+      return;
+    }
+    seenGeneration = generation;
+    while (runNextChunk(lock)) {
+    }
+  }
+}
+
+void WorkerPool::parallelFor(int count,
+                             int minChunkSize,
+                             const std::function<void(int, int)>& fn) {
+  if (count <= 0) {
+    return;
+  }
+  const int numThreads = getNumThreads();
+  const int chunkSize = std::max(std::max(1, minChunkSize),
+                                 (count + numThreads - 1) / numThreads);
+  if (threads.empty() || chunkSize >= count) {
+    fn(0, count);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  job = fn;
+  jobCount = count;
+  jobChunkSize = chunkSize;
+  nextChunk = 0;
+  numChunks = (count + chunkSize - 1) / chunkSize;
+  chunksDone = 0;
+  generation++;
+  workCv.notify_all();
+
+  while (runNextChunk(lock)) {
+  }
+  doneCv.wait(lock, [&] { return chunksDone == numChunks; });
+  job = nullptr;
+}
+
+} // namespace sdl2w
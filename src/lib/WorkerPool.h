@@ -0,0 +1,52 @@
+// A WorkerPool is a small set of persistent threads used to split large,
+// independent batches of work (animation updates, software raster tiles)
+// across cores.  Under Emscripten (no pthreads in the default build) all work
+// runs inline on the calling thread.
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sdl2w {
+
+class WorkerPool {
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable workCv;
+  std::condition_variable doneCv;
+  std::function<void(int, int)> job;
+  int jobCount = 0;
+  int jobChunkSize = 0;
+  int nextChunk = 0;
+  int numChunks = 0;
+  int chunksDone = 0;
+  unsigned int generation = 0;
+  bool stopping = false;
+
+  void workerMain();
+  bool runNextChunk(std::unique_lock<std::mutex>& lock);
+
+public:
+  // numThreads <= 0 picks one worker per hardware thread.  The calling thread
+  // always participates, so a pool of N threads spawns N - 1 workers.
+  WorkerPool(int numThreads = 0);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  int getNumThreads() const { return static_cast<int>(threads.size()) + 1; }
+
+  // Calls fn(begin, end) over [0, count) in chunks of at least minChunkSize,
+  // blocking until every chunk has finished.
+  void parallelFor(int count,
+                   int minChunkSize,
+                   const std::function<void(int, int)>& fn);
+
+  static int getHardwareThreads();
+};
+
+} // namespace sdl2w
@@ -0,0 +1,558 @@
+#include "WorldStreamer.h"
+#include "AssetLoader.h"
+#include "Draw.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "Store.h"
+#include "TileMap.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#if __has_include(<SDL.h>)
+#include <SDL.h>
+#include <SDL_image.h>
+#else
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#endif
+
+namespace sdl2w {
+
+namespace {
+constexpr std::string_view ANIM_TILE_PREFIX = "anim:";
+constexpr std::string_view EMPTY_TILE_NAME = "-";
+
+int getChunkX(int64_t key) { return static_cast<int32_t>(key & 0xffffffff); }
+int getChunkY(int64_t key) { return static_cast<int32_t>(key >> 32); }
+} // namespace
+
+WorldStreamer::WorldStreamer(Draw& drawA,
+                             Store& storeA,
+                             TileMap& tileMapA,
+                             const WorldStreamerParams& paramsA)
+    : draw(drawA), store(storeA), tileMap(tileMapA), params(paramsA) {
+  if (params.chunkTiles <= 0 || params.loadRadius < 0 ||
+      params.unloadRadius < params.loadRadius) {
+    LOG_LINE(ERROR) << "[sdl2w] Invalid WorldStreamer params: chunkTiles="
+                    << params.chunkTiles << " loadRadius=" << params.loadRadius
+                    << " unloadRadius=" << params.unloadRadius << Logger::endl;
+    throw std::runtime_error(std::string(FAIL_ERROR_TEXT));
+  }
+  const TileMapParams& mapParams = tileMap.getParams();
+  chunksX = (mapParams.widthTiles + params.chunkTiles - 1) / params.chunkTiles;
+  chunksY =
+      (mapParams.heightTiles + params.chunkTiles - 1) / params.chunkTiles;
+#ifndef __EMSCRIPTEN__
+  loader = std::thread(&WorldStreamer::loaderMain, this);
+#endif
+}
+
+WorldStreamer::~WorldStreamer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  requestCv.notify_all();
+  if (loader.joinable()) {
+    loader.join();
+  }
+  for (auto& data : loaded) {
+    freeChunkData(*data);
+  }
+  if (applying) {
+    freeChunkData(*applying);
+  }
+}
+
+int64_t WorldStreamer::getChunkKey(int cx, int cy) const {
+  return (static_cast<int64_t>(cy) << 32) | static_cast<uint32_t>(cx);
+}
+
+void WorldStreamer::loaderMain() {
+  while (true) {
+    int64_t key = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      requestCv.wait(lock, [this] { return stopping || !requests.empty(); });
+      if (stopping) {
+        return;
+      }
+      key = requests.front();
+      requests.pop_front();
+    }
+    std::unique_ptr<ChunkData> data = readChunk(key);
+    std::lock_guard<std::mutex> lock(mutex);
+    loaded.push_back(std::move(data));
+  }
+}
+
+// Runs on the loader thread, so it reports problems through data->warnings
+// instead of logging.
+std::unique_ptr<WorldStreamer::ChunkData> WorldStreamer::readChunk(
+    int64_t key) {
+  SDL2W_ZONE("WorldStreamer::readChunk");
+  auto data = std::make_unique<ChunkData>();
+  data->cx = getChunkX(key);
+  data->cy = getChunkY(key);
+
+  const std::string path = params.directory + "/chunk_" +
+                           std::to_string(data->cx) + "_" +
+                           std::to_string(data->cy) + ".txt";
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return data;
+  }
+
+  std::unordered_map<std::string, int> nextSpriteIndex;
+  std::string line;
+  while (std::getline(file, line)) {
+    const std::string trimmed = trim(line);
+    if (trimmed.empty() || trimmed[0] == '#') {
+      continue;
+    }
+    std::vector<std::string> tokens;
+    split(trimmed, ",", tokens);
+    for (auto& token : tokens) {
+      token = trim(token);
+    }
+    const std::string& command = tokens[0];
+
+    try {
+      if (command == "Pic" && tokens.size() >= 3) {
+        Picture picture{.alias = tokens[1], .path = tokens[2]};
+        bool resident = false;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          resident = residentAliases.count(picture.alias) > 0;
+        }
+        if (!resident) {
+          SDL2W_ZONE("WorldStreamer::decodePicture");
+          picture.surf = IMG_Load(picture.path.c_str());
+          if (picture.surf == nullptr) {
+            picture.failed = true;
+            data->warnings.push_back("Failed to decode picture '" +
+                                     picture.path + "' in " + path + ": " +
+                                     IMG_GetError() + ", skipping it");
+          }
+        }
+        data->pictures.push_back(std::move(picture));
+      } else if (command == "Sprites" && tokens.size() >= 5) {
+        SpriteSheet sheet{.picture = tokens[1],
+                          .count = std::stoi(tokens[2]),
+                          .w = std::stoi(tokens[3]),
+                          .h = std::stoi(tokens[4])};
+        sheet.first = nextSpriteIndex[sheet.picture];
+        nextSpriteIndex[sheet.picture] += sheet.count;
+        data->sheets.push_back(std::move(sheet));
+      } else if (command == "Row" && tokens.size() >= 3) {
+        Row row{.layer = std::stoi(tokens[1]), .y = std::stoi(tokens[2])};
+        row.tiles.assign(tokens.begin() + 3, tokens.end());
+        data->rows.push_back(std::move(row));
+      } else if (command == "Spawn" && tokens.size() >= 4) {
+        data->spawns.push_back(WorldSpawn{.type = tokens[1],
+                                          .x = std::stoi(tokens[2]),
+                                          .y = std::stoi(tokens[3]),
+                                          .chunkX = data->cx,
+                                          .chunkY = data->cy});
+      } else {
+        data->warnings.push_back("Unknown or malformed line in " + path +
+                                 ": '" + line + "'");
+      }
+    } catch (const std::exception& e) {
+      data->warnings.push_back("Invalid number in " + path + ": '" + line +
+                               "' - " + e.what());
+    }
+  }
+  return data;
+}
+
+void WorldStreamer::freeChunkData(ChunkData& data) {
+  for (Picture& picture : data.pictures) {
+    if (picture.surf != nullptr) {
+      SDL_FreeSurface(picture.surf);
+      picture.surf = nullptr;
+    }
+  }
+}
+
+// Takes a reference on a picture, uploading it if this is the first chunk
+// that uses it.  Returns false, taking nothing, for a picture the loader could
+// not decode.
+bool WorldStreamer::acquirePicture(Picture& picture) {
+  auto it = pictures.find(picture.alias);
+  if (it != pictures.end() || store.hasTexture(picture.alias)) {
+    PictureRef& ref = pictures[picture.alias];
+    if (ref.refs == 0) {
+      ref.external = true;
+    }
+    ref.refs++;
+    if (picture.surf != nullptr) {
+      SDL_FreeSurface(picture.surf);
+      picture.surf = nullptr;
+    }
+    return true;
+  }
+  if (picture.surf == nullptr) {
+    // already warned about by the loader; sprites and tiles using the
+    // picture are skipped
+    return false;
+  }
+
+  SDL_Texture* tex = nullptr;
+  {
+    SDL2W_ZONE("WorldStreamer::uploadPicture");
+    tex = draw.createTexture(picture.surf);
+  }
+  SDL_FreeSurface(picture.surf);
+  picture.surf = nullptr;
+  store.storeTexture(picture.alias, tex);
+  int width;
+  int height;
+  SDL_QueryTexture(tex, nullptr, nullptr, &width, &height);
+  store.storeSprite(picture.alias,
+                    new Sprite{picture.alias,
+                               Renderable{tex, nullptr},
+                               0,
+                               0,
+                               width,
+                               height,
+                               width,
+                               false});
+
+  PictureRef& ref = pictures[picture.alias];
+  ref.refs = 1;
+  ref.sprites.push_back(picture.alias);
+  spriteOwners[picture.alias] = picture.alias;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    residentAliases.insert(picture.alias);
+  }
+  stats.uploadedPictures++;
+  return true;
+}
+
+// A chunk drawing a sprite cut from another chunk's picture keeps that
+// picture loaded until it unloads itself.
+void WorldStreamer::holdSpriteOwner(Chunk& chunk, const std::string& sprite) {
+  auto owner = spriteOwners.find(sprite);
+  if (owner == spriteOwners.end() ||
+      std::find(chunk.pictures.begin(), chunk.pictures.end(), owner->second) !=
+          chunk.pictures.end()) {
+    return;
+  }
+  pictures[owner->second].refs++;
+  chunk.pictures.push_back(owner->second);
+}
+
+void WorldStreamer::releasePicture(const std::string& alias) {
+  auto it = pictures.find(alias);
+  if (it == pictures.end() || --it->second.refs > 0) {
+    return;
+  }
+  if (!it->second.external) {
+    for (const std::string& sprite : it->second.sprites) {
+      store.removeSprite(sprite);
+      spriteOwners.erase(sprite);
+    }
+    store.removeTexture(alias);
+    // the TileMap still points at the removed sprites
+    tileMap.refreshSprites();
+    std::lock_guard<std::mutex> lock(mutex);
+    residentAliases.erase(alias);
+  }
+  pictures.erase(it);
+}
+
+// Applies a chunk read by the loader.  Returns APPLY_PAUSED when the deadline
+// passed before every picture was uploaded; the next call continues where
+// this one stopped.
+WorldStreamer::ApplyResult WorldStreamer::applyChunk(ChunkData& data,
+                                                     uint64_t deadline) {
+  SDL2W_ZONE("WorldStreamer::applyChunk");
+  Chunk& chunk = chunks[getChunkKey(data.cx, data.cy)];
+  for (const std::string& warning : data.warnings) {
+    LOG(WARN) << "[sdl2w] " << warning << Logger::endl;
+  }
+  data.warnings.clear();
+
+  while (data.nextPicture < data.pictures.size()) {
+    // always upload at least one picture per update so a tiny budget still
+    // makes progress
+    if (stats.uploadedPictures > 0 && SDL_GetPerformanceCounter() >= deadline) {
+      return APPLY_PAUSED;
+    }
+    Picture& picture = data.pictures[data.nextPicture];
+    if (picture.surf == nullptr && !picture.failed &&
+        pictures.find(picture.alias) == pictures.end() &&
+        !store.hasTexture(picture.alias)) {
+      // resident when the chunk was read, but released since; decoding it
+      // here would be outside the budget, so the loader reads the chunk again
+      for (const std::string& alias : chunk.pictures) {
+        releasePicture(alias);
+      }
+      chunk.pictures.clear();
+      return APPLY_RETRY;
+    }
+    if (acquirePicture(picture)) {
+      chunk.pictures.push_back(picture.alias);
+    }
+    data.nextPicture++;
+  }
+
+  bool spritesChanged = stats.uploadedPictures > 0;
+  for (const SpriteSheet& sheet : data.sheets) {
+    if (!store.hasSprite(sheet.picture) || sheet.w <= 0 || sheet.h <= 0) {
+      LOG(WARN) << "[sdl2w] Sprites for unknown picture '" << sheet.picture
+                << "' in chunk " << data.cx << "," << data.cy << Logger::endl;
+      continue;
+    }
+    const Sprite& base = store.getSprite(sheet.picture);
+    auto ref = pictures.find(sheet.picture);
+    const int numX = std::max(1, base.w / sheet.w);
+    for (int i = sheet.first; i < sheet.first + sheet.count; i++) {
+      const std::string name = sheet.picture + "_" + std::to_string(i);
+      if (store.hasSprite(name)) {
+        continue;
+      }
+      store.storeSprite(name,
+                        new Sprite{name,
+                                   base.renderable,
+                                   (i % numX) * sheet.w,
+                                   (i / numX) * sheet.h,
+                                   sheet.w,
+                                   sheet.h,
+                                   base.w,
+                                   false});
+      if (ref != pictures.end() && !ref->second.external) {
+        ref->second.sprites.push_back(name);
+        spriteOwners[name] = sheet.picture;
+      }
+      spritesChanged = true;
+    }
+  }
+  if (spritesChanged) {
+    tileMap.refreshSprites();
+  }
+
+  const TileMapParams& mapParams = tileMap.getParams();
+  const int x0 = data.cx * params.chunkTiles;
+  const int y0 = data.cy * params.chunkTiles;
+  const int x1 = std::min(x0 + params.chunkTiles, mapParams.widthTiles);
+  const int y1 = std::min(y0 + params.chunkTiles, mapParams.heightTiles);
+  for (const Row& row : data.rows) {
+    const int y = y0 + row.y;
+    if (row.layer < 0 || row.layer >= mapParams.numLayers || y < y0 ||
+        y >= y1) {
+      LOG(WARN) << "[sdl2w] Row out of range in chunk " << data.cx << ","
+                << data.cy << ": layer=" << row.layer << " y=" << row.y
+                << Logger::endl;
+      continue;
+    }
+    const int numTiles =
+        std::min(static_cast<int>(row.tiles.size()), x1 - x0);
+    for (int i = 0; i < numTiles; i++) {
+      const std::string& tile = row.tiles[i];
+      TileMap::TileId id = TileMap::EMPTY_TILE;
+      if (tile == EMPTY_TILE_NAME) {
+        id = TileMap::EMPTY_TILE;
+      } else if (tile.starts_with(ANIM_TILE_PREFIX)) {
+        id = tileMap.getAnimationTileId(
+            std::string_view(tile).substr(ANIM_TILE_PREFIX.size()));
+      } else if (store.hasSprite(tile)) {
+        holdSpriteOwner(chunk, tile);
+        id = tileMap.getSpriteTileId(tile);
+      } else {
+        LOG(WARN) << "[sdl2w] Unknown tile sprite '" << tile << "' in chunk "
+                  << data.cx << "," << data.cy << Logger::endl;
+      }
+      tileMap.setTile(row.layer, x0 + i, y, id);
+    }
+  }
+
+  if (onSpawn) {
+    for (const WorldSpawn& spawn : data.spawns) {
+      onSpawn(spawn);
+    }
+  }
+  return APPLY_DONE;
+}
+
+void WorldStreamer::unloadChunk(int64_t key) {
+  auto it = chunks.find(key);
+  if (it == chunks.end()) {
+    return;
+  }
+  const int cx = getChunkX(key);
+  const int cy = getChunkY(key);
+
+  if (it->second.state == CHUNK_LOADED) {
+    const TileMapParams& mapParams = tileMap.getParams();
+    const int x0 = cx * params.chunkTiles;
+    const int y0 = cy * params.chunkTiles;
+    const int x1 = std::min(x0 + params.chunkTiles, mapParams.widthTiles);
+    const int y1 = std::min(y0 + params.chunkTiles, mapParams.heightTiles);
+    for (int layer = 0; layer < mapParams.numLayers; layer++) {
+      for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+          tileMap.setTile(layer, x, y, TileMap::EMPTY_TILE);
+        }
+      }
+    }
+    if (onChunkUnloaded) {
+      onChunkUnloaded(cx, cy);
+    }
+  } else {
+    std::lock_guard<std::mutex> lock(mutex);
+    requests.erase(std::remove(requests.begin(), requests.end(), key),
+                   requests.end());
+  }
+
+  if (applying && applying->cx == cx && applying->cy == cy) {
+    freeChunkData(*applying);
+    applying.reset();
+  }
+  for (const std::string& alias : it->second.pictures) {
+    releasePicture(alias);
+  }
+  chunks.erase(it);
+}
+
+void WorldStreamer::update(double focusX, double focusY) {
+  SDL2W_ZONE("WorldStreamer::update");
+  const uint64_t start = SDL_GetPerformanceCounter();
+  const uint64_t deadline =
+      start + static_cast<uint64_t>(params.uploadBudgetMs *
+                                    SDL_GetPerformanceFrequency() / 1000.);
+  stats.appliedChunks = 0;
+  stats.uploadedPictures = 0;
+
+  const TileMapParams& mapParams = tileMap.getParams();
+  const int focusCx = static_cast<int>(
+      std::floor(focusX / (params.chunkTiles * mapParams.tileWidth)));
+  const int focusCy = static_cast<int>(
+      std::floor(focusY / (params.chunkTiles * mapParams.tileHeight)));
+
+  std::vector<int64_t> farChunks;
+  for (const auto& [key, chunk] : chunks) {
+    const int dist = std::max(std::abs(getChunkX(key) - focusCx),
+                              std::abs(getChunkY(key) - focusCy));
+    if (dist > params.unloadRadius) {
+      farChunks.push_back(key);
+    }
+  }
+  for (const int64_t key : farChunks) {
+    unloadChunk(key);
+  }
+
+  // nearest chunks are requested first
+  std::vector<std::pair<int, int64_t>> wanted;
+  for (int cy = std::max(0, focusCy - params.loadRadius);
+       cy <= std::min(chunksY - 1, focusCy + params.loadRadius);
+       cy++) {
+    for (int cx = std::max(0, focusCx - params.loadRadius);
+         cx <= std::min(chunksX - 1, focusCx + params.loadRadius);
+         cx++) {
+      const int64_t key = getChunkKey(cx, cy);
+      if (chunks.find(key) == chunks.end()) {
+        const int dist =
+            std::max(std::abs(cx - focusCx), std::abs(cy - focusCy));
+        wanted.push_back({dist, key});
+      }
+    }
+  }
+  if (!wanted.empty()) {
+    std::sort(wanted.begin(), wanted.end());
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (const auto& [dist, key] : wanted) {
+        chunks[key] = Chunk();
+        requests.push_back(key);
+      }
+    }
+    requestCv.notify_one();
+  }
+
+  while (true) {
+    if (!applying) {
+#ifdef __EMSCRIPTEN__
+      int64_t key = 0;
+      bool hasRequest = false;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (loaded.empty() && !requests.empty() && stats.appliedChunks == 0) {
+          key = requests.front();
+          requests.pop_front();
+          hasRequest = true;
+        }
+      }
+      if (hasRequest) {
+        std::unique_ptr<ChunkData> data = readChunk(key);
+        std::lock_guard<std::mutex> lock(mutex);
+        loaded.push_back(std::move(data));
+      }
+#endif
+      std::lock_guard<std::mutex> lock(mutex);
+      if (loaded.empty()) {
+        break;
+      }
+      applying = std::move(loaded.front());
+      loaded.pop_front();
+    }
+
+    // dropped or already applied while the loader was reading it
+    auto it = chunks.find(getChunkKey(applying->cx, applying->cy));
+    if (it == chunks.end() || it->second.state != CHUNK_REQUESTED) {
+      freeChunkData(*applying);
+      applying.reset();
+      continue;
+    }
+
+    const ApplyResult result = applyChunk(*applying, deadline);
+    if (result == APPLY_PAUSED) {
+      break;
+    }
+    if (result == APPLY_RETRY) {
+      const int64_t key = it->first;
+      freeChunkData(*applying);
+      applying.reset();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_front(key);
+      }
+      requestCv.notify_one();
+      continue;
+    }
+    it->second.state = CHUNK_LOADED;
+    applying.reset();
+    stats.appliedChunks++;
+    if (SDL_GetPerformanceCounter() >= deadline) {
+      break;
+    }
+  }
+
+  stats.loadedChunks = 0;
+  for (const auto& [key, chunk] : chunks) {
+    if (chunk.state == CHUNK_LOADED) {
+      stats.loadedChunks++;
+    }
+  }
+  stats.pendingChunks = static_cast<int>(chunks.size()) - stats.loadedChunks;
+  stats.residentPictures = static_cast<int>(pictures.size());
+  stats.updateMs = static_cast<double>(SDL_GetPerformanceCounter() - start) *
+                   1000. / static_cast<double>(SDL_GetPerformanceFrequency());
+}
+
+void WorldStreamer::update() {
+  const auto [renderW, renderH] = draw.getRenderSize();
+  const auto [focusX, focusY] =
+      draw.screenToWorld(renderW / 2., renderH / 2.);
+  update(focusX, focusY);
+}
+
+bool WorldStreamer::isChunkLoaded(int cx, int cy) const {
+  auto it = chunks.find(getChunkKey(cx, cy));
+  return it != chunks.end() && it->second.state == CHUNK_LOADED;
+}
+
+} // namespace sdl2w
@@ -0,0 +1,207 @@
+// A WorldStreamer keeps the part of a large world near a focus point (usually
+// the camera) loaded.  The world is stored as one text file per chunk.  Chunks
+// within loadRadius of the focus are read and their pictures decoded on a
+// background thread, then applied on the main thread by update(), which stops
+// once uploadBudgetMs has been spent so streaming can't cause a hitch.  A
+// chunk is unloaded once the focus is more than unloadRadius chunks away;
+// unloadRadius is larger than loadRadius so moving back and forth over a chunk
+// border doesn't reload it.
+//
+// Tiles are written into a TileMap covering the whole world.  Pictures go
+// through the Store under their alias and are shared: a picture referenced by
+// several loaded chunks is uploaded once and removed from the Store when the
+// last of them unloads.  A chunk whose rows use sprites of a picture loaded by
+// another chunk counts as one of them.  Pictures that were already in the
+// Store (loaded by an AssetLoader, for example) are used as they are and never
+// removed.  A picture that fails to decode is logged and skipped, along with
+// the tiles that use it.
+// Animations used by animated tiles must be loaded up front.
+//
+// Chunk files are <directory>/chunk_<cx>_<cy>.txt and use the asset file
+// syntax.  A missing file is an empty chunk.
+//
+//   # Pic,<alias>,<path from executable>
+//   Pic,forest,assets/forest.png
+//   # Sprites,<pic alias>,<num sprites>,<sprite width>,<sprite height>
+//   Sprites,forest,8,16,16
+//   # Row,<layer>,<y in chunk>,<tile>,<tile>,...
+//   # a tile is a sprite name, anim:<animation name>, or - for empty
+//   Row,0,0,forest_0,forest_1,-,anim:water
+//   # Spawn,<type>,<x>,<y> in world pixels
+//   Spawn,slime,120,64
+//
+// Under Emscripten (no pthreads in the default build) chunks are read and
+// decoded by update() on the main thread, one per call.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct SDL_Surface;
+
+namespace sdl2w {
+class Draw;
+class Store;
+class TileMap;
+
+struct WorldStreamerParams {
+  std::string directory;
+  // chunks are chunkTiles x chunkTiles tiles of the TileMap
+  int chunkTiles = 32;
+  // in chunks, measured as the larger of the x and y distance
+  int loadRadius = 2;
+  int unloadRadius = 3;
+  double uploadBudgetMs = 2.;
+};
+
+struct WorldSpawn {
+  std::string type;
+  int x = 0;
+  int y = 0;
+  int chunkX = 0;
+  int chunkY = 0;
+};
+
+struct WorldStreamerStats {
+  int loadedChunks = 0;
+  // requested but not yet applied
+  int pendingChunks = 0;
+  int residentPictures = 0;
+  // by the last update()
+  int appliedChunks = 0;
+  int uploadedPictures = 0;
+  double updateMs = 0.;
+};
+
+class WorldStreamer {
+  struct Picture {
+    std::string alias;
+    std::string path;
+    // decoded by the loader thread; nullptr when the picture was already
+    // resident when the chunk was read, or could not be decoded
+    SDL_Surface* surf = nullptr;
+    bool failed = false;
+  };
+
+  struct SpriteSheet {
+    std::string picture;
+    int first = 0;
+    int count = 0;
+    int w = 0;
+    int h = 0;
+  };
+
+  struct Row {
+    int layer = 0;
+    int y = 0;
+    std::vector<std::string> tiles;
+  };
+
+  // Everything read from one chunk file.
+  struct ChunkData {
+    int cx = 0;
+    int cy = 0;
+    std::vector<Picture> pictures;
+    std::vector<SpriteSheet> sheets;
+    std::vector<Row> rows;
+    std::vector<WorldSpawn> spawns;
+    // logged from the main thread
+    std::vector<std::string> warnings;
+    size_t nextPicture = 0;
+  };
+
+  enum ChunkState {
+    CHUNK_REQUESTED,
+    CHUNK_LOADED,
+  };
+
+  enum ApplyResult {
+    APPLY_DONE,
+    // out of upload budget, continue on the next update
+    APPLY_PAUSED,
+    // a picture was released after the chunk was read; read it again
+    APPLY_RETRY,
+  };
+
+  struct Chunk {
+    ChunkState state = CHUNK_REQUESTED;
+    // pictures this chunk holds a reference on: its own Pic lines and the
+    // owners of every streamed sprite its rows use
+    std::vector<std::string> pictures;
+  };
+
+  struct PictureRef {
+    int refs = 0;
+    // sprites cut from this picture, removed with it
+    std::vector<std::string> sprites;
+    bool external = false;
+  };
+
+  Draw& draw;
+  Store& store;
+  TileMap& tileMap;
+  WorldStreamerParams params;
+  int chunksX = 0;
+  int chunksY = 0;
+
+  // main thread only
+  std::unordered_map<int64_t, Chunk> chunks;
+  std::unordered_map<std::string, PictureRef> pictures;
+  // sprite name -> alias of the streamed picture it was cut from
+  std::unordered_map<std::string, std::string> spriteOwners;
+  std::unique_ptr<ChunkData> applying;
+  WorldStreamerStats stats;
+
+  // shared with the loader thread
+  std::mutex mutex;
+  std::condition_variable requestCv;
+  std::deque<int64_t> requests;
+  std::deque<std::unique_ptr<ChunkData>> loaded;
+  std::unordered_set<std::string> residentAliases;
+  std::thread loader;
+  bool stopping = false;
+
+  int64_t getChunkKey(int cx, int cy) const;
+  void loaderMain();
+  std::unique_ptr<ChunkData> readChunk(int64_t key);
+  void freeChunkData(ChunkData& data);
+  ApplyResult applyChunk(ChunkData& data, uint64_t deadline);
+  bool acquirePicture(Picture& picture);
+  void holdSpriteOwner(Chunk& chunk, const std::string& sprite);
+  void releasePicture(const std::string& alias);
+  void unloadChunk(int64_t key);
+
+public:
+  std::function<void(const WorldSpawn&)> onSpawn;
+  std::function<void(int, int)> onChunkUnloaded;
+
+  WorldStreamer(Draw& drawA,
+                Store& storeA,
+                TileMap& tileMapA,
+                const WorldStreamerParams& paramsA);
+  ~WorldStreamer();
+  WorldStreamer(const WorldStreamer&) = delete;
+  WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+  // Requests and unloads chunks around the focus (world pixels), then applies
+  // loaded chunks until the upload budget is spent.  update() with no
+  // arguments focuses on the center of the Draw camera.
+  void update(double focusX, double focusY);
+  void update();
+
+  bool isChunkLoaded(int cx, int cy) const;
+  const WorldStreamerStats& getStats() const { return stats; }
+};
+
+} // namespace sdl2w
@@ -455,6 +455,10 @@ void runProgram(int argc,
                        });
 
   window.getDraw().setBackgroundColor({16, 30, 41});
+  // the viewer is mostly still UI; only redraw what changes
+  window.getDraw().setDirtyRectMode(true);
+  // and only render when there is input or something is playing
+  window.setIdleMode(true);
 
   AssetLoader assetLoader(window.getDraw(), window.getStore());
   reloadAssets(assetLoader, store, assetLoadConfig);
@@ -545,6 +549,8 @@ void runProgram(int argc,
           reloadButton.handleMousedown(x, y, [&](const std::string&) {
             LOG(INFO) << "Reloading assets..." << LOG_ENDL;
             reloadAssets(assetLoader, store, assetLoadConfig);
+            // new textures may reuse the addresses of the old ones
+            window.getDraw().invalidate();
             reloadAssetBrowserData();
             notifMessage = "Assets reloaded!";
             notifTime = 0;
@@ -609,6 +615,8 @@ void runProgram(int argc,
           reloadButton.handleMousedown(x, y, [&](const std::string&) {
             LOG(INFO) << "Reloading assets..." << LOG_ENDL;
             reloadAssets(assetLoader, store, assetLoadConfig);
+            // new textures may reuse the addresses of the old ones
+            window.getDraw().invalidate();
             reloadAssetBrowserData();
             state.selectedAnimNames.clear();
             state.selectedAnimDefinitions.clear();
@@ -731,6 +739,7 @@ void runProgram(int argc,
           if (state.selectedAnim.has_value()) {
             auto& anim = state.selectedAnim.value();
             anim.update(window.getDeltaTime());
+            window.requestRedraw();
             d.drawAnimation(anim,
                             sdl2w::RenderableParams{
                                 .scale = {state.scale, state.scale},
@@ -771,6 +780,7 @@ void runProgram(int argc,
           if (notifTime > notifDuration) {
             notifMessage = "";
           } else {
+            window.requestRedraw();
             d.drawText(notifMessage,
                        RenderTextParams{
                            .fontName = "default",